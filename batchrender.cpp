@@ -0,0 +1,350 @@
+// Copyright (C) 2016 The Qt Company Ltd.
+// SPDX-License-Identifier: LicenseRef-Qt-Commercial OR BSD-3-Clause
+
+#include <QGuiApplication>
+#include <QCommandLineParser>
+#include <QCommandLineOption>
+#include <QOffscreenSurface>
+#include <QOpenGLContext>
+#include <QOpenGLFunctions>
+#include <QOpenGLFramebufferObject>
+#include <QImageWriter>
+#include <QThread>
+#include <QMutex>
+#include <QWaitCondition>
+#include <QQueue>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QDir>
+#include <QJsonObject>
+#include <QJsonDocument>
+#include <QTextStream>
+
+#include "latticerenderer.h"
+#include "volumerenderer.h"
+#include "frameparser.h"
+
+/*
+ * Renders a stream of frames in the device protocol, from a file or stdin,
+ * into numbered images without a window. Every worker thread has its own
+ * offscreen context, Logo and renderer, and takes the next parsed frame
+ * when it is done with its last one; frames are complete LED states, so
+ * the order they are drawn in does not matter. The view is the one of a
+ * GLWidget with its sliders at the given angles. Prints a JSON report.
+ */
+
+// Parsed frames waiting for a worker, per worker.
+#define BATCH_QUEUE_DEPTH 4
+#define BATCH_READ_SIZE 65536
+
+struct BatchJob
+{
+    CubeConfig config;
+    QSize size;
+    bool core = false;
+    bool volume = false;
+    QMatrix4x4 proj;
+    QMatrix4x4 modelView;
+    QMatrix3x3 normalMatrix;
+    QString directory;
+    QByteArray format;
+};
+
+struct WorkerResult
+{
+    int rendered = 0;
+    int failed = 0;
+};
+
+/*
+ * Bounded hand over from the parser to the workers. push() blocks while
+ * the queue is full and gives up once every worker has left.
+ */
+class FrameQueue
+{
+public:
+    FrameQueue(int capacity, int consumers) : m_capacity(capacity), m_consumers(consumers) {}
+
+    bool push(const LedFrame &frame)
+    {
+        QMutexLocker locker(&m_mutex);
+        while (m_frames.size() >= m_capacity && m_consumers > 0)
+            m_notFull.wait(&m_mutex);
+        if (m_consumers == 0)
+            return false;
+        m_frames.enqueue({ m_pushed++, frame });
+        m_notEmpty.wakeOne();
+        return true;
+    }
+
+    // False once the queue is closed and empty.
+    bool pop(LedFrame *frame, int *index)
+    {
+        QMutexLocker locker(&m_mutex);
+        while (m_frames.isEmpty() && !m_closed)
+            m_notEmpty.wait(&m_mutex);
+        if (m_frames.isEmpty())
+            return false;
+        Entry entry = m_frames.dequeue();
+        *index = entry.index;
+        *frame = std::move(entry.frame);
+        m_notFull.wakeOne();
+        return true;
+    }
+
+    void close()
+    {
+        QMutexLocker locker(&m_mutex);
+        m_closed = true;
+        m_notEmpty.wakeAll();
+    }
+
+    // A worker that cannot render any more.
+    void leave()
+    {
+        QMutexLocker locker(&m_mutex);
+        --m_consumers;
+        m_notFull.wakeAll();
+    }
+
+private:
+    struct Entry
+    {
+        int index;
+        LedFrame frame;
+    };
+
+    QMutex m_mutex;
+    QWaitCondition m_notEmpty;
+    QWaitCondition m_notFull;
+    QQueue<Entry> m_frames;
+    int m_capacity;
+    int m_consumers;
+    int m_pushed = 0;
+    bool m_closed = false;
+};
+
+static void renderFrames(QOffscreenSurface *surface, const BatchJob &job, FrameQueue *queue, WorkerResult *result)
+{
+    QOpenGLContext context;
+    context.setFormat(surface->format());
+    if (!context.create() || !context.makeCurrent(surface)) {
+        qWarning("Cannot create an offscreen context");
+        queue->leave();
+        return;
+    }
+
+    {
+        QOpenGLFunctions *f = context.functions();
+        Logo logo(job.config);
+        LatticeRenderer renderer(&logo);
+        VolumeRenderer volumeRenderer({ &logo });
+        bool volume = job.volume;
+        if (volume && !volumeRenderer.initialize()) {
+            qWarning("Volume rendering needs OpenGL 3.2 or OpenGL ES 3.0, drawing meshes");
+            volume = false;
+        }
+        if (!volume)
+            renderer.initialize(job.core);
+
+        QOpenGLFramebufferObject fbo(job.size, QOpenGLFramebufferObject::CombinedDepthStencil);
+        fbo.bind();
+        f->glViewport(0, 0, job.size.width(), job.size.height());
+        f->glClearColor(0, 0, 0, 1);
+
+        LedFrame frame;
+        int index;
+        while (queue->pop(&frame, &index)) {
+            f->glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+            f->glEnable(GL_DEPTH_TEST);
+            f->glEnable(GL_CULL_FACE);
+            logo.apply(frame);
+            if (volume)
+                volumeRenderer.render(job.proj, job.modelView, job.normalMatrix);
+            else
+                renderer.render(job.proj, job.modelView, job.normalMatrix);
+
+            // Encoding is most of the cost, and runs on every worker at once.
+            const QString fileName = QDir(job.directory).filePath(
+                    QString::asprintf("frame-%06d.%s", index, job.format.constData()));
+            if (fbo.toImage().save(fileName, job.format.constData()))
+                ++result->rendered;
+            else
+                ++result->failed;
+        }
+        fbo.release();
+        renderer.release();
+        volumeRenderer.release();
+    }
+    context.doneCurrent();
+    queue->leave();
+}
+
+int main(int argc, char *argv[])
+{
+    QGuiApplication app(argc, argv);
+
+    QCoreApplication::setApplicationName("LED cube batch renderer");
+    QCommandLineParser parser;
+    parser.setApplicationDescription(QCoreApplication::applicationName());
+    parser.addHelpOption();
+    parser.addPositionalArgument("input", "Frames in the device protocol, - or none for stdin", "[input]");
+    QCommandLineOption outputOption("output", "Directory the images are written to", "directory", "frames");
+    parser.addOption(outputOption);
+    QCommandLineOption formatOption("format", "Image format", "format", "png");
+    parser.addOption(formatOption);
+    QCommandLineOption resolutionOption("resolution", "Image size", "WxH", "400x400");
+    parser.addOption(resolutionOption);
+    QCommandLineOption threadsOption("threads", "Render threads, 0 for one per core", "threads", "0");
+    parser.addOption(threadsOption);
+    QCommandLineOption renderOption("render", "How LEDs are drawn: mesh or volume", "mode", "mesh");
+    parser.addOption(renderOption);
+    QCommandLineOption coreProfileOption("coreprofile", "Use core profile");
+    parser.addOption(coreProfileOption);
+    QCommandLineOption rotationOption("rotation", "View angles around x, y and z in degrees", "x,y,z", "0,0,0");
+    parser.addOption(rotationOption);
+    QCommandLineOption distanceOption("distance", "Camera distance, the lattice spans 0.4", "units", "1");
+    parser.addOption(distanceOption);
+    QCommandLineOption lodOption("lod", "Merge bricks of LEDs smaller than <pixels>, 0 to disable", "pixels",
+                                 QString::number(LatticeLod::threshold()));
+    parser.addOption(lodOption);
+    QCommandLineOption cubeConfigOption("cubeconfig", "Load cube dimensions and pin maps from <file>", "file");
+    parser.addOption(cubeConfigOption);
+    QCommandLineOption cubeSizeOption("cubesize", "Cube dimensions, e.g. 8 or 16x16x8", "size");
+    parser.addOption(cubeSizeOption);
+
+    parser.process(app);
+
+    BatchJob job;
+    QString error;
+    if (parser.isSet(cubeConfigOption) && !job.config.load(parser.value(cubeConfigOption), &error)) {
+        qWarning("Cannot load cube config: %s", qPrintable(error));
+        return 1;
+    }
+    if (parser.isSet(cubeSizeOption) && !job.config.setSize(parser.value(cubeSizeOption), &error)) {
+        qWarning("%s", qPrintable(error));
+        return 1;
+    }
+    const QStringList resolution = parser.value(resolutionOption).split('x');
+    job.size = QSize(resolution.value(0).toInt(), resolution.value(1).toInt());
+    if (job.size.isEmpty()) {
+        qWarning("Invalid resolution \"%s\"", qPrintable(parser.value(resolutionOption)));
+        return 1;
+    }
+    job.format = parser.value(formatOption).toLatin1();
+    if (!QImageWriter::supportedImageFormats().contains(job.format)) {
+        qWarning("Unsupported image format \"%s\"", job.format.constData());
+        return 1;
+    }
+    const QString mode = parser.value(renderOption);
+    if (mode != QLatin1String("mesh") && mode != QLatin1String("volume")) {
+        qWarning("Unknown render mode \"%s\"", qPrintable(mode));
+        return 1;
+    }
+    job.volume = mode == QLatin1String("volume");
+    job.core = parser.isSet(coreProfileOption);
+    job.directory = parser.value(outputOption);
+    if (!QDir().mkpath(job.directory)) {
+        qWarning("Cannot create %s", qPrintable(job.directory));
+        return 1;
+    }
+    LatticeLod::setThreshold(parser.value(lodOption).toFloat());
+
+    // As GLWidget::paintGL() draws it, the sliders at the given angles.
+    const QStringList angles = parser.value(rotationOption).split(',');
+    QMatrix4x4 world;
+    world.rotate(180.0f - angles.value(0).toFloat(), 1, 0, 0);
+    world.rotate(angles.value(1).toFloat(), 0, 1, 0);
+    world.rotate(angles.value(2).toFloat(), 0, 0, 1);
+    QMatrix4x4 camera;
+    camera.translate(0, 0, -parser.value(distanceOption).toFloat());
+    job.proj.perspective(45.0f, GLfloat(job.size.width()) / job.size.height(), 0.01f, 100.0f);
+    job.modelView = camera * world;
+    job.normalMatrix = world.normalMatrix();
+
+    const QString inputName = parser.positionalArguments().value(0, QStringLiteral("-"));
+    QFile input;
+    bool opened;
+    if (inputName == QLatin1String("-")) {
+        opened = input.open(stdin, QIODevice::ReadOnly);
+    } else {
+        input.setFileName(inputName);
+        opened = input.open(QIODevice::ReadOnly);
+    }
+    if (!opened) {
+        qWarning("Cannot read %s: %s", qPrintable(inputName), qPrintable(input.errorString()));
+        return 1;
+    }
+
+    QSurfaceFormat fmt;
+    fmt.setDepthBufferSize(24);
+    if (job.core) {
+        fmt.setVersion(3, 3);
+        fmt.setProfile(QSurfaceFormat::CoreProfile);
+    }
+    const int threadCount = parser.value(threadsOption).toInt() > 0
+            ? parser.value(threadsOption).toInt() : QThread::idealThreadCount();
+
+    // Surfaces can only be made on the GUI thread, the contexts are made
+    // by the workers using them.
+    FrameQueue queue(threadCount * BATCH_QUEUE_DEPTH, threadCount);
+    QList<QOffscreenSurface *> surfaces;
+    QList<QThread *> workers;
+    QList<WorkerResult> results(threadCount);
+    QElapsedTimer timer;
+    timer.start();
+    for (int i = 0; i < threadCount; ++i) {
+        QOffscreenSurface *surface = new QOffscreenSurface;
+        surface->setFormat(fmt);
+        surface->create();
+        surfaces.append(surface);
+        WorkerResult *result = &results[i];
+        QThread *worker = QThread::create([surface, &job, &queue, result] {
+            renderFrames(surface, job, &queue, result);
+        });
+        worker->start();
+        workers.append(worker);
+    }
+
+    // Parsing stays on this thread, ahead of the workers by the queue.
+    FrameParser frameParser(job.config);
+    bool abandoned = false;
+    frameParser.setFrameHandler([&queue, &abandoned](const LedFrame &frame) {
+        if (!abandoned && !queue.push(frame))
+            abandoned = true;
+    });
+    QByteArray buffer(BATCH_READ_SIZE, Qt::Uninitialized);
+    qint64 read;
+    while (!abandoned && (read = input.read(buffer.data(), buffer.size())) > 0)
+        frameParser.feed(buffer.constData(), read);
+    queue.close();
+    for (QThread *worker : workers)
+        worker->wait();
+    qDeleteAll(workers);
+    qDeleteAll(surfaces);
+    const double seconds = timer.nsecsElapsed() / 1e9;
+
+    QJsonObject report;
+    int rendered = 0;
+    int failed = 0;
+    for (const WorkerResult &result : results) {
+        rendered += result.rendered;
+        failed += result.failed;
+    }
+    report["frames_parsed"] = qint64(frameParser.framesParsed());
+    report["frames_rendered"] = rendered;
+    report["write_errors"] = failed;
+    report["threads"] = threadCount;
+    report["seconds"] = seconds;
+    report["frames_per_second"] = seconds > 0 ? rendered / seconds : 0.0;
+    report["size"] = QString("%1x%2x%3").arg(job.config.sizeX).arg(job.config.sizeY).arg(job.config.sizeZ);
+    report["resolution"] = QString("%1x%2").arg(job.size.width()).arg(job.size.height());
+    report["mode"] = job.volume ? "volume" : "mesh";
+    QTextStream(stdout) << QJsonDocument(report).toJson();
+
+    if (abandoned) {
+        qWarning("No render thread could be started");
+        return 1;
+    }
+    return failed == 0 ? 0 : 1;
+}
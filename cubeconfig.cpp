@@ -0,0 +1,156 @@
+// Copyright (C) 2016 The Qt Company Ltd.
+// SPDX-License-Identifier: LicenseRef-Qt-Commercial OR BSD-3-Clause
+
+#include "cubeconfig.h"
+#include <QFileInfo>
+#include <QSettings>
+#include <QStringList>
+
+static CubeConfig s_current;
+
+static bool parsePins(const QVariant &value, int size, QList<unsigned int> *pins, QString *error)
+{
+    const QStringList list = value.toStringList();
+    if (list.size() != size) {
+        *error = QStringLiteral("expected %1 pins, got %2").arg(size).arg(list.size());
+        return false;
+    }
+
+    pins->clear();
+    for (const QString &s : list) {
+        bool ok = false;
+        const unsigned int pin = s.trimmed().toUInt(&ok);
+        if (!ok || pin >= MAX_PIN_NUMBER) {
+            *error = QStringLiteral("invalid pin \"%1\"").arg(s);
+            return false;
+        }
+        pins->append(pin);
+    }
+    return true;
+}
+
+CubeConfig::CubeConfig()
+{
+    resetPins();
+}
+
+void CubeConfig::resetPins()
+{
+    xPins.clear();
+    yPins.clear();
+    zPins.clear();
+
+    if (sizeX == 5 && sizeY == 5 && sizeZ == 5) {
+        xPins = {X0, X1, X2, X3, X4};
+        yPins = {Y0, Y1, Y2, Y3, Y4};
+        zPins = {Z0, Z1, Z2, Z3, Z4};
+        return;
+    }
+
+    // Without a pin map, layer n is driven by pin n.
+    for (int i = 0; i < sizeX; ++i)
+        xPins.append(i);
+    for (int i = 0; i < sizeY; ++i)
+        yPins.append(i);
+    for (int i = 0; i < sizeZ; ++i)
+        zPins.append(i);
+}
+
+bool CubeConfig::setSize(const QString &spec, QString *error)
+{
+    // Accepts "N" for a cube or "XxYxZ".
+    const QStringList parts = spec.split(QLatin1Char('x'), Qt::SkipEmptyParts);
+    if (parts.size() != 1 && parts.size() != 3) {
+        *error = QStringLiteral("invalid cube size \"%1\"").arg(spec);
+        return false;
+    }
+
+    int dims[3];
+    for (int i = 0; i < 3; ++i) {
+        bool ok = false;
+        dims[i] = parts.at(parts.size() == 1 ? 0 : i).toInt(&ok);
+        if (!ok || dims[i] < 1 || dims[i] > MAX_CUBE_SIZE) {
+            *error = QStringLiteral("invalid cube size \"%1\", each side must be 1..%2")
+                    .arg(spec).arg(MAX_CUBE_SIZE);
+            return false;
+        }
+    }
+
+    // Pin maps loaded for this size, e.g. by --cubeconfig before
+    // --cubesize, stay.
+    if (sizeX == dims[0] && sizeY == dims[1] && sizeZ == dims[2])
+        return true;
+    sizeX = dims[0];
+    sizeY = dims[1];
+    sizeZ = dims[2];
+    resetPins();
+    return true;
+}
+
+bool CubeConfig::load(const QString &fileName, QString *error)
+{
+    if (!QFileInfo::exists(fileName)) {
+        *error = QStringLiteral("%1: no such file").arg(fileName);
+        return false;
+    }
+
+    // [cube]
+    // size=8x8x8
+    // xPins=0,1,2,3,4,5,6,7
+    QSettings settings(fileName, QSettings::IniFormat);
+    if (settings.status() != QSettings::NoError) {
+        *error = QStringLiteral("%1: cannot parse").arg(fileName);
+        return false;
+    }
+
+    settings.beginGroup(QStringLiteral("cube"));
+    if (settings.contains(QStringLiteral("size"))
+            && !setSize(settings.value(QStringLiteral("size")).toString(), error)) {
+        *error = QStringLiteral("%1: %2").arg(fileName, *error);
+        return false;
+    }
+
+    const struct {
+        const char *key;
+        int size;
+        QList<unsigned int> *pins;
+    } axes[] = {
+        { "xPins", sizeX, &xPins },
+        { "yPins", sizeY, &yPins },
+        { "zPins", sizeZ, &zPins },
+    };
+    for (const auto &axis : axes) {
+        const QString key = QLatin1String(axis.key);
+        if (settings.contains(key) && !parsePins(settings.value(key), axis.size, axis.pins, error)) {
+            *error = QStringLiteral("%1: %2: %3").arg(fileName, key, *error);
+            return false;
+        }
+    }
+    settings.endGroup();
+
+    return isValid(error);
+}
+
+bool CubeConfig::isValid(QString *error) const
+{
+    const QList<unsigned int> *axes[] = { &xPins, &yPins, &zPins };
+    for (const QList<unsigned int> *pins : axes) {
+        for (int i = 0; i < pins->size(); ++i) {
+            if (pins->indexOf(pins->at(i)) != i) {
+                *error = QStringLiteral("pin %1 is mapped twice").arg(pins->at(i));
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+const CubeConfig &CubeConfig::current()
+{
+    return s_current;
+}
+
+void CubeConfig::setCurrent(const CubeConfig &config)
+{
+    s_current = config;
+}
@@ -0,0 +1,63 @@
+// Copyright (C) 2016 The Qt Company Ltd.
+// SPDX-License-Identifier: LicenseRef-Qt-Commercial OR BSD-3-Clause
+
+#ifndef CUBECONFIG_H
+#define CUBECONFIG_H
+
+#include <QList>
+#include <QString>
+
+#define MAX_CUBE_SIZE 64
+#define MAX_PIN_NUMBER 256
+
+// Pin map of the original 5x5x5 board, used when no other map is given.
+#define X0 15U
+#define X1 13U
+#define X2 12U
+#define X3 11U
+#define X4 10U
+#define Y0 14U
+#define Y1 16U
+#define Y2 17U
+#define Y3 18U
+#define Y4 19U
+#define Z0 27U
+#define Z1 26U
+#define Z2 22U
+#define Z3 21U
+#define Z4 20U
+
+/*
+ * Cube dimensions and the pin number that drives each layer on every axis.
+ * LEDs are addressed linearly as (x * sizeY + y) * sizeZ + z everywhere:
+ * in the state model, in binary frames and in the instance buffers.
+ */
+struct CubeConfig
+{
+    int sizeX = 5;
+    int sizeY = 5;
+    int sizeZ = 5;
+    QList<unsigned int> xPins;
+    QList<unsigned int> yPins;
+    QList<unsigned int> zPins;
+
+    CubeConfig();
+
+    int ledCount() const { return sizeX * sizeY * sizeZ; }
+    int maxSize() const { return qMax(sizeX, qMax(sizeY, sizeZ)); }
+    int index(int x, int y, int z) const { return (x * sizeY + y) * sizeZ + z; }
+
+    // A new size resets the pin maps to the defaults, the same size keeps
+    // them.
+    bool setSize(const QString &spec, QString *error);
+    bool load(const QString &fileName, QString *error);
+    bool isValid(QString *error) const;
+
+    static const CubeConfig &current();
+    static void setCurrent(const CubeConfig &config);
+
+private:
+    void resetPins();
+};
+
+#endif // CUBECONFIG_H
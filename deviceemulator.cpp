@@ -0,0 +1,198 @@
+// Copyright (C) 2016 The Qt Company Ltd.
+// SPDX-License-Identifier: LicenseRef-Qt-Commercial OR BSD-3-Clause
+
+#include "deviceemulator.h"
+#include <QTcpServer>
+#include <QTcpSocket>
+#include <QTimer>
+#include <QDeadlineTimer>
+#include <QDebug>
+
+// Largest write when fragmenting at random.
+static const int MaxChunkSize = 64;
+
+DeviceEmulator::DeviceEmulator(const CubeConfig &config, QObject *parent)
+    : QObject(parent)
+    , m_config(config)
+    , m_sentAt(new std::atomic<qint64>[65536])
+{
+    for (int i = 0; i < 65536; ++i)
+        m_sentAt[i].store(0, std::memory_order_relaxed);
+
+    // Every LED is three "Xnn:" style tokens, prebuilt per axis and layer.
+    const QList<unsigned int> *pins[3] = { &m_config.xPins, &m_config.yPins, &m_config.zPins };
+    for (int axis = 0; axis < 3; ++axis) {
+        for (unsigned int pin : *pins[axis])
+            m_pinTokens[axis].append(char('X' + axis) + QByteArray::number(pin) + ':');
+    }
+}
+
+DeviceEmulator::~DeviceEmulator()
+{
+    stop();
+}
+
+bool DeviceEmulator::fragmentationFromString(const QString &name, Fragmentation *fragmentation)
+{
+    if (name == QLatin1String("whole"))
+        *fragmentation = WholeFrames;
+    else if (name == QLatin1String("random"))
+        *fragmentation = RandomChunks;
+    else if (name == QLatin1String("bytes"))
+        *fragmentation = SingleBytes;
+    else
+        return false;
+    return true;
+}
+
+void DeviceEmulator::start()
+{
+    // Created here so the server and timer belong to the thread this object
+    // was moved to.
+    m_server = new QTcpServer(this);
+    connect(m_server, &QTcpServer::newConnection, this, &DeviceEmulator::newConnection);
+    m_timer = new QTimer(this);
+    m_timer->setTimerType(Qt::PreciseTimer);
+    connect(m_timer, &QTimer::timeout, this, &DeviceEmulator::tick);
+
+    if (!m_server->listen(m_address, m_port)) {
+        qWarning() << "Emulator cannot listen on" << m_address << m_port << ":" << m_server->errorString();
+        return;
+    }
+    qDebug() << "Emulator listening on" << m_server->serverAddress() << m_server->serverPort();
+    emit listening(m_server->serverPort());
+}
+
+bool DeviceEmulator::isListening() const
+{
+    return m_server && m_server->isListening();
+}
+
+void DeviceEmulator::stop()
+{
+    if (m_timer)
+        m_timer->stop();
+    if (m_client) {
+        m_client->abort();
+        delete m_client;
+        m_client = nullptr;
+    }
+    delete m_server;
+    m_server = nullptr;
+}
+
+void DeviceEmulator::newConnection()
+{
+    while (QTcpSocket *socket = m_server->nextPendingConnection()) {
+        // The cube serves one viewer, a new one replaces the old.
+        if (m_client) {
+            m_client->disconnect(this);
+            m_client->abort();
+            m_client->deleteLater();
+        }
+        m_client = socket;
+        m_client->setSocketOption(QAbstractSocket::LowDelayOption, 1);
+        connect(m_client, &QTcpSocket::readyRead, this, &DeviceEmulator::readyRead);
+        connect(m_client, &QTcpSocket::disconnected, this, [this, socket] {
+            if (socket != m_client)
+                return;
+            m_timer->stop();
+            m_client->deleteLater();
+            m_client = nullptr;
+            emit clientDisconnected();
+        });
+        emit clientConnected();
+    }
+
+    m_input.clear();
+    m_awaitingAck = false;
+    m_tickPending = false;
+    if (m_frameRate > 0)
+        m_timer->start(qMax(1, qRound(1000.0 / m_frameRate)));
+    sendFrame();
+}
+
+void DeviceEmulator::readyRead()
+{
+    m_input.append(m_client->readAll());
+
+    qsizetype end;
+    while ((end = m_input.indexOf('\n')) >= 0) {
+        const QByteArray line = m_input.left(end).trimmed();
+        m_input.remove(0, end + 1);
+        if (line != "S")
+            continue;
+
+        m_acksReceived.fetch_add(1, std::memory_order_relaxed);
+        m_awaitingAck = false;
+        if (m_frameRate <= 0 || m_tickPending) {
+            m_tickPending = false;
+            sendFrame();
+        }
+    }
+}
+
+void DeviceEmulator::tick()
+{
+    if (m_awaitingAck) {
+        m_framesStalled.fetch_add(1, std::memory_order_relaxed);
+        m_tickPending = true;
+        return;
+    }
+    sendFrame();
+}
+
+void DeviceEmulator::buildFrame()
+{
+    m_frame.clear();
+    if (m_sequenced)
+        m_frame.append('#').append(QByteArray::number(m_sequence)).append(':');
+
+    for (int x = 0; x < m_config.sizeX; ++x) {
+        for (int y = 0; y < m_config.sizeY; ++y) {
+            for (int z = 0; z < m_config.sizeZ; ++z) {
+                if (m_random.generateDouble() >= m_fillRatio)
+                    continue;
+                m_frame.append(m_pinTokens[0].at(x));
+                m_frame.append(m_pinTokens[1].at(y));
+                m_frame.append(m_pinTokens[2].at(z));
+            }
+        }
+    }
+    m_frame.append("----\r\n");
+}
+
+void DeviceEmulator::sendFrame()
+{
+    if (!m_client || m_awaitingAck)
+        return;
+
+    buildFrame();
+    m_sentAt[m_sequence].store(QDeadlineTimer::current(Qt::PreciseTimer).deadlineNSecs(),
+                               std::memory_order_release);
+    writeFragmented(m_frame.constData(), m_frame.size());
+    ++m_sequence;
+    m_awaitingAck = true;
+    m_framesSent.fetch_add(1, std::memory_order_relaxed);
+    m_bytesSent.fetch_add(quint64(m_frame.size()), std::memory_order_relaxed);
+}
+
+void DeviceEmulator::writeFragmented(const char *data, qsizetype size)
+{
+    if (m_fragmentation == WholeFrames) {
+        m_client->write(data, size);
+        return;
+    }
+
+    // Flushing every piece hands it to the kernel on its own, with
+    // LowDelayOption set it usually leaves as a segment of its own too.
+    qsizetype pos = 0;
+    while (pos < size) {
+        const qsizetype chunk = m_fragmentation == SingleBytes
+                ? 1
+                : qMin(size - pos, qsizetype(m_random.bounded(1, MaxChunkSize + 1)));
+        m_client->write(data + pos, chunk);
+        m_client->flush();
+        pos += chunk;
+    }
+}
@@ -0,0 +1,110 @@
+// Copyright (C) 2016 The Qt Company Ltd.
+// SPDX-License-Identifier: LicenseRef-Qt-Commercial OR BSD-3-Clause
+
+#ifndef DEVICEEMULATOR_H
+#define DEVICEEMULATOR_H
+
+#include <QObject>
+#include <QHostAddress>
+#include <QByteArray>
+#include <QRandomGenerator>
+#include <atomic>
+#include <memory>
+#include "cubeconfig.h"
+
+QT_FORWARD_DECLARE_CLASS(QTcpServer)
+QT_FORWARD_DECLARE_CLASS(QTcpSocket)
+QT_FORWARD_DECLARE_CLASS(QTimer)
+
+/*
+ * Stands in for the cube on a local port. Sends random text frames
+ * "X..:Y..:Z..:...:----\r\n" and, like the firmware, waits for "S\r\n"
+ * before the next one. Binary and window requests are ignored, so the
+ * receiver talks to it as to old firmware. Frames can be written whole,
+ * in random chunks or byte by byte to exercise the parser.
+ *
+ * Frames are sent exactly as the device does by default. With sequencing
+ * on they are numbered with a leading "#n:" token, an extension the real
+ * firmware does not have.
+ * sentAt() gives the send time of a sequence number so an in-process
+ * consumer can measure latency; it may be called from any thread.
+ */
+class DeviceEmulator : public QObject
+{
+    Q_OBJECT
+
+public:
+    enum Fragmentation {
+        WholeFrames,
+        RandomChunks,
+        SingleBytes
+    };
+
+    explicit DeviceEmulator(const CubeConfig &config = CubeConfig::current(), QObject *parent = nullptr);
+    ~DeviceEmulator();
+
+    static bool fragmentationFromString(const QString &name, Fragmentation *fragmentation);
+
+    // Only call before start().
+    void setListenAddress(const QHostAddress &address, quint16 port) { m_address = address; m_port = port; }
+    // A rate of 0 sends the next frame as soon as the previous one is acked.
+    void setFrameRate(double fps) { m_frameRate = qMax(0.0, fps); }
+    void setFillRatio(double ratio) { m_fillRatio = qBound(0.0, ratio, 1.0); }
+    void setFragmentation(Fragmentation fragmentation) { m_fragmentation = fragmentation; }
+    void setSequenced(bool sequenced) { m_sequenced = sequenced; }
+    void setSeed(quint32 seed) { m_random.seed(seed); }
+
+    bool isListening() const;
+    qint64 sentAt(quint16 sequence) const { return m_sentAt[sequence].load(std::memory_order_acquire); }
+    quint64 framesSent() const { return m_framesSent.load(std::memory_order_relaxed); }
+    quint64 bytesSent() const { return m_bytesSent.load(std::memory_order_relaxed); }
+    quint64 acksReceived() const { return m_acksReceived.load(std::memory_order_relaxed); }
+    // Rate ticks that found the previous frame still unacknowledged.
+    quint64 framesStalled() const { return m_framesStalled.load(std::memory_order_relaxed); }
+
+public slots:
+    void start();
+    void stop();
+
+signals:
+    void listening(quint16 port);
+    void clientConnected();
+    void clientDisconnected();
+
+private slots:
+    void newConnection();
+    void readyRead();
+    void tick();
+
+private:
+    void buildFrame();
+    void sendFrame();
+    void writeFragmented(const char *data, qsizetype size);
+
+    CubeConfig m_config;
+    QHostAddress m_address = QHostAddress::LocalHost;
+    quint16 m_port = 0;
+    double m_frameRate = 30.0;
+    double m_fillRatio = 0.2;
+    Fragmentation m_fragmentation = WholeFrames;
+    bool m_sequenced = false;
+
+    QTcpServer *m_server = nullptr;
+    QTcpSocket *m_client = nullptr;
+    QTimer *m_timer = nullptr;
+    QRandomGenerator m_random;
+    QByteArray m_input;
+    QByteArray m_frame;
+    QList<QByteArray> m_pinTokens[3];
+    quint16 m_sequence = 0;
+    bool m_awaitingAck = false;
+    bool m_tickPending = false;
+
+    std::unique_ptr<std::atomic<qint64>[]> m_sentAt;
+    std::atomic<quint64> m_framesSent { 0 };
+    std::atomic<quint64> m_bytesSent { 0 };
+    std::atomic<quint64> m_acksReceived { 0 };
+    std::atomic<quint64> m_framesStalled { 0 };
+};
+
+#endif // DEVICEEMULATOR_H
@@ -0,0 +1,99 @@
+// Copyright (C) 2016 The Qt Company Ltd.
+// SPDX-License-Identifier: LicenseRef-Qt-Commercial OR BSD-3-Clause
+
+#include "devicepool.h"
+#include <QThread>
+
+QList<DevicePool::Device> DevicePool::m_devices;
+int DevicePool::m_threadCount = 0;
+
+DevicePool::DevicePool(const CubeConfig &config, QObject *parent)
+    : QObject(parent)
+{
+    QList<Device> devices = m_devices;
+    if (devices.isEmpty())
+        devices.append({ FrameReceiver::hostName(), FrameReceiver::port() });
+
+    const int threads = qBound(1, m_threadCount ? m_threadCount : QThread::idealThreadCount(),
+                               int(devices.size()));
+    for (int i = 0; i < threads; ++i) {
+        QThread *thread = new QThread(this);
+        thread->setObjectName(QStringLiteral("DevicePool %1").arg(i));
+        m_threads.append(thread);
+    }
+
+    for (int i = 0; i < devices.size(); ++i) {
+        FrameReceiver *receiver = new FrameReceiver(config);
+        receiver->setDevice(devices.at(i).hostName, devices.at(i).port);
+        QThread *thread = m_threads.at(i % threads);
+        receiver->moveToThread(thread);
+        connect(thread, &QThread::started, receiver, &FrameReceiver::start);
+        connect(thread, &QThread::finished, receiver, &QObject::deleteLater);
+        // Queued to this thread, the device index rides along.
+        connect(receiver, &FrameReceiver::frameAvailable, this, [this, i] {
+            emit frameAvailable(i);
+        });
+        connect(receiver, &FrameReceiver::connectionStateChanged, this,
+                [this, i](FrameReceiver::ConnectionState state) {
+            m_states[i] = state;
+            emit connectionStateChanged(i, state);
+        });
+        m_receivers.append(receiver);
+        m_names.append(QStringLiteral("%1:%2").arg(devices.at(i).hostName).arg(devices.at(i).port));
+        m_states.append(FrameReceiver::Disconnected);
+    }
+}
+
+DevicePool::~DevicePool()
+{
+    stop();
+}
+
+bool DevicePool::deviceFromString(const QString &text, Device *device, QString *error)
+{
+    const int colon = text.lastIndexOf(QLatin1Char(':'));
+    device->hostName = colon < 0 ? text : text.left(colon);
+    device->port = FrameReceiver::port();
+    if (colon >= 0) {
+        bool ok = false;
+        device->port = text.mid(colon + 1).toUShort(&ok);
+        if (!ok || device->port == 0) {
+            *error = QStringLiteral("Invalid port in device \"%1\"").arg(text);
+            return false;
+        }
+    }
+    if (device->hostName.isEmpty()) {
+        *error = QStringLiteral("No host in device \"%1\"").arg(text);
+        return false;
+    }
+    return true;
+}
+
+void DevicePool::start()
+{
+    for (QThread *thread : m_threads)
+        thread->start();
+}
+
+void DevicePool::stop()
+{
+    // The receivers delete themselves when their thread finishes.
+    for (QThread *thread : m_threads)
+        thread->quit();
+    for (QThread *thread : m_threads)
+        thread->wait();
+    m_receivers.clear();
+}
+
+int DevicePool::connectedCount() const
+{
+    return int(m_states.count(FrameReceiver::Connected));
+}
+
+quint64 DevicePool::framesDropped() const
+{
+    quint64 dropped = 0;
+    for (const FrameReceiver *receiver : m_receivers)
+        dropped += receiver->framesDropped();
+    return dropped;
+}
@@ -0,0 +1,71 @@
+// Copyright (C) 2016 The Qt Company Ltd.
+// SPDX-License-Identifier: LicenseRef-Qt-Commercial OR BSD-3-Clause
+
+#ifndef DEVICEPOOL_H
+#define DEVICEPOOL_H
+
+#include <QObject>
+#include <QList>
+#include <QStringList>
+#include "framereceiver.h"
+
+QT_FORWARD_DECLARE_CLASS(QThread)
+
+/*
+ * Connections to any number of cubes of the same size. Every device gets
+ * its own FrameReceiver, so its own socket, parser and frame ring, and the
+ * receivers are spread round robin over a fixed pool of worker threads.
+ * Socket reads and decoding therefore scale with the cores while the GUI
+ * thread only picks up finished frames, one frameAvailable() per batch and
+ * device. Without any devices set the process wide FrameReceiver endpoint,
+ * or the replayed session, is the single device.
+ */
+class DevicePool : public QObject
+{
+    Q_OBJECT
+
+public:
+    struct Device
+    {
+        QString hostName;
+        quint16 port = 0;
+    };
+
+    explicit DevicePool(const CubeConfig &config = CubeConfig::current(), QObject *parent = nullptr);
+    ~DevicePool();
+
+    static QList<Device> devices() { return m_devices; }
+    static void setDevices(const QList<Device> &devices) { m_devices = devices; }
+    static int deviceCount() { return qMax(1, int(m_devices.size())); }
+    // "host:port", or just "host" for the default port.
+    static bool deviceFromString(const QString &text, Device *device, QString *error);
+    // 0 picks one thread per core.
+    static int threadCount() { return m_threadCount; }
+    static void setThreadCount(int threads) { m_threadCount = qMax(0, threads); }
+
+    int size() const { return m_names.size(); }
+    QString deviceName(int device) const { return m_names.at(device); }
+    // Null once the pool has been stopped.
+    FrameReceiver *receiver(int device) const { return m_receivers.value(device); }
+    int workerCount() const { return m_threads.size(); }
+    int connectedCount() const;
+    quint64 framesDropped() const;
+
+public slots:
+    void start();
+    void stop();
+
+signals:
+    void frameAvailable(int device);
+    void connectionStateChanged(int device, FrameReceiver::ConnectionState state);
+
+private:
+    QList<QThread *> m_threads;
+    QList<FrameReceiver *> m_receivers;
+    QStringList m_names;
+    QList<FrameReceiver::ConnectionState> m_states;
+    static QList<Device> m_devices;
+    static int m_threadCount;
+};
+
+#endif // DEVICEPOOL_H
@@ -0,0 +1,89 @@
+// Copyright (C) 2016 The Qt Company Ltd.
+// SPDX-License-Identifier: LicenseRef-Qt-Commercial OR BSD-3-Clause
+
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QCommandLineOption>
+#include <QTimer>
+#include <QDebug>
+
+#include "deviceemulator.h"
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+
+    QCoreApplication::setApplicationName("LED cube device emulator");
+    QCommandLineParser parser;
+    parser.setApplicationDescription(QCoreApplication::applicationName());
+    parser.addHelpOption();
+    QCommandLineOption listenOption("listen", "Address to listen on", "address", "127.0.0.1");
+    parser.addOption(listenOption);
+    QCommandLineOption portOption("port", "Port to listen on", "port", "1234");
+    parser.addOption(portOption);
+    QCommandLineOption rateOption("rate", "Frames per second, 0 for as fast as acks arrive", "fps", "30");
+    parser.addOption(rateOption);
+    QCommandLineOption fillOption("fill", "Ratio of lit LEDs per frame", "ratio", "0.2");
+    parser.addOption(fillOption);
+    QCommandLineOption fragmentOption("fragment", "How frames are written: whole, random or bytes", "mode", "whole");
+    parser.addOption(fragmentOption);
+    QCommandLineOption sequenceOption("sequence", "Number frames with a leading #n: token, not sent by the device");
+    parser.addOption(sequenceOption);
+    QCommandLineOption cubeConfigOption("cubeconfig", "Load cube dimensions and pin maps from <file>", "file");
+    parser.addOption(cubeConfigOption);
+    QCommandLineOption cubeSizeOption("cubesize", "Cube dimensions, e.g. 8 or 16x16x8", "size");
+    parser.addOption(cubeSizeOption);
+
+    parser.process(app);
+
+    CubeConfig cubeConfig;
+    QString error;
+    if (parser.isSet(cubeConfigOption) && !cubeConfig.load(parser.value(cubeConfigOption), &error)) {
+        qWarning("%s", qPrintable(error));
+        return 1;
+    }
+    if (parser.isSet(cubeSizeOption) && !cubeConfig.setSize(parser.value(cubeSizeOption), &error)) {
+        qWarning("%s", qPrintable(error));
+        return 1;
+    }
+
+    DeviceEmulator::Fragmentation fragmentation;
+    if (!DeviceEmulator::fragmentationFromString(parser.value(fragmentOption), &fragmentation)) {
+        qWarning("Unknown fragmentation \"%s\"", qPrintable(parser.value(fragmentOption)));
+        return 1;
+    }
+
+    bool portOk = false;
+    const quint16 port = parser.value(portOption).toUShort(&portOk);
+    if (!portOk || port == 0) {
+        qWarning("Invalid port \"%s\"", qPrintable(parser.value(portOption)));
+        return 1;
+    }
+
+    DeviceEmulator emulator(cubeConfig);
+    emulator.setListenAddress(QHostAddress(parser.value(listenOption)), port);
+    emulator.setFrameRate(parser.value(rateOption).toDouble());
+    emulator.setFillRatio(parser.value(fillOption).toDouble());
+    emulator.setFragmentation(fragmentation);
+    emulator.setSequenced(parser.isSet(sequenceOption));
+    QObject::connect(&emulator, &DeviceEmulator::clientConnected, [] { qDebug() << "Client connected"; });
+    QObject::connect(&emulator, &DeviceEmulator::clientDisconnected, [] { qDebug() << "Client disconnected"; });
+    emulator.start();
+    if (!emulator.isListening())
+        return 1;
+
+    QTimer stats;
+    quint64 lastFrames = 0;
+    quint64 lastBytes = 0;
+    QObject::connect(&stats, &QTimer::timeout, [&] {
+        const quint64 frames = emulator.framesSent();
+        const quint64 bytes = emulator.bytesSent();
+        qDebug() << "Sent" << frames - lastFrames << "frames/s" << bytes - lastBytes << "bytes/s"
+                 << "stalled" << emulator.framesStalled();
+        lastFrames = frames;
+        lastBytes = bytes;
+    });
+    stats.start(1000);
+
+    return app.exec();
+}
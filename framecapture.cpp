@@ -0,0 +1,217 @@
+// Copyright (C) 2016 The Qt Company Ltd.
+// SPDX-License-Identifier: LicenseRef-Qt-Commercial OR BSD-3-Clause
+
+#include "framecapture.h"
+#include "framepacer.h"
+#include "pipelinestats.h"
+#include <QOpenGLContext>
+#include <QOpenGLFramebufferObject>
+#include <QDir>
+#include <QThread>
+#include <QDebug>
+#include <cstring>
+
+// How long stop() waits for a read back, ns.
+#define CAPTURE_STOP_TIMEOUT 1000000000
+
+FrameCapture::FrameCapture()
+{
+    m_pool.setObjectName(QStringLiteral("capture"));
+}
+
+FrameCapture::~FrameCapture()
+{
+    m_pool.waitForDone();
+}
+
+bool FrameCapture::formatFromString(const QString &name, Format *format)
+{
+    if (name == QLatin1String("png"))
+        *format = Png;
+    else if (name == QLatin1String("jpg"))
+        *format = Jpeg;
+    else if (name == QLatin1String("raw"))
+        *format = Raw;
+    else
+        return false;
+    return true;
+}
+
+bool FrameCapture::initialize()
+{
+    initializeOpenGLFunctions();
+
+    QOpenGLContext *context = QOpenGLContext::currentContext();
+    const QSurfaceFormat ctxFormat = context->format();
+    m_initialized = context->isOpenGLES()
+            ? ctxFormat.majorVersion() >= 3
+            : ctxFormat.version() >= qMakePair(3, 2);
+    return m_initialized;
+}
+
+void FrameCapture::cleanup()
+{
+    if (!m_initialized)
+        return;
+    // Frames in flight are lost with the context.
+    for (Slot &slot : m_slots) {
+        if (slot.fence) {
+            glDeleteSync(slot.fence);
+            slot.fence = nullptr;
+            m_droppedGpu.fetch_add(1, std::memory_order_relaxed);
+        }
+        slot.buffer.destroy();
+        slot.size = QSize();
+    }
+    delete m_resolve;
+    m_resolve = nullptr;
+    m_initialized = false;
+}
+
+bool FrameCapture::start(const QString &directory, Format format, QString *error)
+{
+    if (!QDir().mkpath(directory)) {
+        *error = QStringLiteral("Cannot create %1").arg(directory);
+        return false;
+    }
+    m_directory = directory;
+    m_format = format;
+    // Images are independent, the raw stream needs its frames in order.
+    m_pool.setMaxThreadCount(format == Raw ? 1 : qMax(1, QThread::idealThreadCount() / 2));
+    m_active = true;
+    return true;
+}
+
+void FrameCapture::stop()
+{
+    if (!m_active)
+        return;
+    if (m_initialized) {
+        for (int i = 0; i < CAPTURE_BUFFER_COUNT; ++i)
+            collect(m_slots[(m_next + i) % CAPTURE_BUFFER_COUNT], true);
+    }
+    m_pool.waitForDone();
+    m_raw.close();
+    m_rawSize = QSize();
+    m_active = false;
+}
+
+void FrameCapture::capture(const QSize &size, bool multisampled)
+{
+    if (!m_active || !m_initialized || size.isEmpty())
+        return;
+
+    const qint64 started = FramePacer::now();
+    const int frame = m_frame++;
+    // Oldest first, whatever the GPU has finished is passed on.
+    for (int i = 0; i < CAPTURE_BUFFER_COUNT; ++i)
+        collect(m_slots[(m_next + i) % CAPTURE_BUFFER_COUNT], false);
+
+    Slot &slot = m_slots[m_next];
+    if (slot.fence) {
+        // Skipped rather than waited for.
+        m_droppedGpu.fetch_add(1, std::memory_order_relaxed);
+        PipelineStats::instance().record(PipelineStats::Capture, FramePacer::now() - started);
+        return;
+    }
+
+    // Multisampled framebuffers are resolved first, they cannot be read.
+    if (multisampled) {
+        if (!m_resolve || m_resolve->size() != size) {
+            delete m_resolve;
+            m_resolve = new QOpenGLFramebufferObject(size);
+        }
+        const QRect rect(QPoint(0, 0), size);
+        QOpenGLFramebufferObject::blitFramebuffer(m_resolve, rect, nullptr, rect);
+        m_resolve->bind();
+    }
+
+    if (!slot.buffer.isCreated()) {
+        slot.buffer.create();
+        slot.buffer.setUsagePattern(QOpenGLBuffer::StreamRead);
+    }
+    slot.buffer.bind();
+    if (slot.size != size)
+        slot.buffer.allocate(size.width() * size.height() * 4);
+    glReadPixels(0, 0, size.width(), size.height(), GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+    slot.buffer.release();
+    slot.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    slot.size = size;
+    slot.frame = frame;
+    m_next = (m_next + 1) % CAPTURE_BUFFER_COUNT;
+
+    if (multisampled)
+        QOpenGLFramebufferObject::bindDefault();
+    PipelineStats::instance().record(PipelineStats::Capture, FramePacer::now() - started);
+}
+
+void FrameCapture::collect(Slot &slot, bool wait)
+{
+    if (!slot.fence)
+        return;
+    const GLenum status = wait
+            ? glClientWaitSync(slot.fence, GL_SYNC_FLUSH_COMMANDS_BIT, CAPTURE_STOP_TIMEOUT)
+            : glClientWaitSync(slot.fence, 0, 0);
+    if (status == GL_TIMEOUT_EXPIRED)
+        return;
+    glDeleteSync(slot.fence);
+    slot.fence = nullptr;
+    if (status == GL_WAIT_FAILED) {
+        m_errors.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    if (m_queued.load(std::memory_order_relaxed) >= CAPTURE_MAX_QUEUED) {
+        m_droppedWriter.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+
+    // Copied out so the buffer is free again right away, rows still
+    // bottom-up.
+    const int bytes = slot.size.width() * slot.size.height() * 4;
+    QImage image(slot.size, QImage::Format_RGBA8888);
+    slot.buffer.bind();
+    const void *pixels = slot.buffer.mapRange(0, bytes, QOpenGLBuffer::RangeRead);
+    if (pixels)
+        memcpy(image.bits(), pixels, bytes);
+    slot.buffer.unmap();
+    slot.buffer.release();
+    if (!pixels) {
+        m_errors.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+
+    m_queued.fetch_add(1, std::memory_order_relaxed);
+    m_captured.fetch_add(1, std::memory_order_relaxed);
+    const int frame = slot.frame;
+    m_pool.start([this, image, frame] {
+        write(image, frame);
+        m_queued.fetch_sub(1, std::memory_order_relaxed);
+    });
+}
+
+void FrameCapture::write(const QImage &image, int frame)
+{
+    const QImage flipped = image.mirrored();
+    bool ok;
+    if (m_format == Raw) {
+        if (m_rawSize.isEmpty()) {
+            m_rawSize = flipped.size();
+            m_raw.setFileName(QDir(m_directory).filePath(QStringLiteral("capture-%1x%2.rgba")
+                                                          .arg(m_rawSize.width()).arg(m_rawSize.height())));
+            if (!m_raw.open(QIODevice::WriteOnly | QIODevice::Truncate))
+                qWarning() << "Cannot write" << m_raw.fileName() << ":" << m_raw.errorString();
+        }
+        // A resized window does not fit the stream, its frames are lost.
+        ok = m_raw.isOpen() && flipped.size() == m_rawSize
+                && m_raw.write(reinterpret_cast<const char *>(flipped.constBits()), flipped.sizeInBytes())
+                   == flipped.sizeInBytes();
+    } else {
+        const QString fileName = QDir(m_directory).filePath(QString::asprintf("frame-%06d.%s", frame,
+                                                                             m_format == Png ? "png" : "jpg"));
+        ok = flipped.save(fileName);
+    }
+    if (ok)
+        m_written.fetch_add(1, std::memory_order_relaxed);
+    else
+        m_errors.fetch_add(1, std::memory_order_relaxed);
+}
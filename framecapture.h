@@ -0,0 +1,103 @@
+// Copyright (C) 2016 The Qt Company Ltd.
+// SPDX-License-Identifier: LicenseRef-Qt-Commercial OR BSD-3-Clause
+
+#ifndef FRAMECAPTURE_H
+#define FRAMECAPTURE_H
+
+#include <QOpenGLExtraFunctions>
+#include <QOpenGLBuffer>
+#include <QThreadPool>
+#include <QImage>
+#include <QFile>
+#include <atomic>
+
+// Pixel pack buffers read back in turn, a frame is collected this many
+// frames after it was drawn.
+#define CAPTURE_BUFFER_COUNT 3
+// Frames waiting for a writer before further ones are dropped.
+#define CAPTURE_MAX_QUEUED 8
+
+QT_FORWARD_DECLARE_CLASS(QOpenGLFramebufferObject)
+
+/*
+ * Records what is drawn without stalling on the GPU. capture() starts an
+ * asynchronous glReadPixels() into the next of CAPTURE_BUFFER_COUNT pixel
+ * pack buffers and fences it; buffers whose fence has passed are mapped,
+ * copied out and handed to a thread pool that encodes and writes them. The
+ * cost per frame is the copy and never a wait:
+ *   dropped_gpu     the buffer due was still being read back
+ *   dropped_writer  CAPTURE_MAX_QUEUED frames were waiting for a writer
+ * Images are numbered by frame, gaps mark dropped captures. Raw is one
+ * stream of top-down RGBA8 frames, capture-WxH.rgba, written in order.
+ *
+ * Needs OpenGL 3.2 or OpenGL ES 3.0 for fences. initialize(), capture(),
+ * stop() and cleanup() want the context current.
+ */
+class FrameCapture : protected QOpenGLExtraFunctions
+{
+public:
+    enum Format {
+        Png,
+        Jpeg,
+        Raw
+    };
+
+    FrameCapture();
+    ~FrameCapture();
+
+    static bool formatFromString(const QString &name, Format *format);
+
+    bool initialize();
+    void cleanup();
+    bool isInitialized() const { return m_initialized; }
+
+    bool start(const QString &directory, Format format, QString *error);
+    // Collects the frames in flight and waits for the writers.
+    void stop();
+    bool isActive() const { return m_active; }
+
+    // Reads back the current context's default framebuffer, after the
+    // frame is drawn.
+    void capture(const QSize &size, bool multisampled);
+
+    quint64 framesCaptured() const { return m_captured.load(std::memory_order_relaxed); }
+    quint64 framesWritten() const { return m_written.load(std::memory_order_relaxed); }
+    quint64 framesDroppedGpu() const { return m_droppedGpu.load(std::memory_order_relaxed); }
+    quint64 framesDroppedWriter() const { return m_droppedWriter.load(std::memory_order_relaxed); }
+    quint64 writeErrors() const { return m_errors.load(std::memory_order_relaxed); }
+
+private:
+    struct Slot
+    {
+        QOpenGLBuffer buffer { QOpenGLBuffer::PixelPackBuffer };
+        GLsync fence = nullptr;
+        QSize size;
+        int frame = 0;
+    };
+
+    void collect(Slot &slot, bool wait);
+    // Writer threads only.
+    void write(const QImage &image, int frame);
+
+    bool m_initialized = false;
+    bool m_active = false;
+    QString m_directory;
+    Format m_format = Png;
+    Slot m_slots[CAPTURE_BUFFER_COUNT];
+    int m_next = 0;
+    int m_frame = 0;
+    QOpenGLFramebufferObject *m_resolve = nullptr;
+    QThreadPool m_pool;
+    // The raw stream, opened by its writer with the first frame.
+    QFile m_raw;
+    QSize m_rawSize;
+
+    std::atomic<int> m_queued { 0 };
+    std::atomic<quint64> m_captured { 0 };
+    std::atomic<quint64> m_written { 0 };
+    std::atomic<quint64> m_droppedGpu { 0 };
+    std::atomic<quint64> m_droppedWriter { 0 };
+    std::atomic<quint64> m_errors { 0 };
+};
+
+#endif // FRAMECAPTURE_H
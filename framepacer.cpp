@@ -0,0 +1,149 @@
+// Copyright (C) 2016 The Qt Company Ltd.
+// SPDX-License-Identifier: LicenseRef-Qt-Commercial OR BSD-3-Clause
+
+#include "framepacer.h"
+#include <QDeadlineTimer>
+
+int FramePacer::m_defaultPlayoutDelay = 50;
+FramePacer::Policy FramePacer::m_defaultPolicy = FramePacer::DropOldest;
+
+// Brightest of both per channel, a LED lit in either frame stays lit.
+static void mergeColors(LedFrame &dst, const LedFrame &src)
+{
+    uchar *d = reinterpret_cast<uchar *>(dst.colors.data());
+    const uchar *s = reinterpret_cast<const uchar *>(src.colors.constData());
+    const qsizetype bytes = dst.colors.size() * qsizetype(sizeof(quint32));
+    for (qsizetype i = 0; i < bytes; ++i)
+        d[i] = qMax(d[i], s[i]);
+}
+
+static void copyFrame(LedFrame &dst, const LedFrame &src)
+{
+    dst.copyStateFrom(src);
+    dst.sequence = src.sequence;
+    dst.sequenced = src.sequenced;
+    dst.binary = src.binary;
+    dst.timestamp = src.timestamp;
+    dst.received = src.received;
+}
+
+FramePacer::FramePacer(int ledCount, int capacity)
+    : m_entries(qMax(1, capacity))
+    , m_playoutDelay(qint64(m_defaultPlayoutDelay) * 1000000)
+    , m_policy(m_defaultPolicy)
+{
+    for (Entry &entry : m_entries)
+        entry.frame.resize(ledCount);
+    m_display.resize(ledCount);
+}
+
+bool FramePacer::policyFromString(const QString &name, Policy *policy)
+{
+    if (name == QLatin1String("drop"))
+        *policy = DropOldest;
+    else if (name == QLatin1String("coalesce"))
+        *policy = Coalesce;
+    else if (name == QLatin1String("slowdown"))
+        *policy = SlowDown;
+    else
+        return false;
+    return true;
+}
+
+qint64 FramePacer::now()
+{
+    return QDeadlineTimer::current(Qt::PreciseTimer).deadlineNSecs();
+}
+
+void FramePacer::push(const LedFrame &frame)
+{
+    const qint64 t = now();
+    const qint64 due = (frame.timestamp ? frame.timestamp : t) + m_playoutDelay;
+
+    // Arriving after its playout slot means the previous frame stayed on
+    // screen for the refreshes in between.
+    if (due < t) {
+        ++m_late;
+        m_duplicated += quint64((t - due) / m_refreshInterval);
+    }
+    // A sequence number seen again is a frame shown twice, in time or not.
+    if (frame.sequenced) {
+        if (m_haveSequence && frame.sequence == m_lastSequence)
+            ++m_duplicated;
+        m_lastSequence = frame.sequence;
+        m_haveSequence = true;
+    }
+
+    if (m_count == m_entries.size()) {
+        popFront();
+        ++m_dropped;
+    }
+
+    Entry &entry = at(m_count);
+    copyFrame(entry.frame, frame);
+    entry.due = due;
+    ++m_count;
+}
+
+const LedFrame *FramePacer::frameForDisplay(qint64 now)
+{
+    if (m_count == 0 || at(0).due > now)
+        return nullptr;
+
+    int due = 1;
+    while (due < m_count && at(due).due <= now)
+        ++due;
+
+    switch (m_policy) {
+    case SlowDown:
+        copyFrame(m_display, at(0).frame);
+        popFront();
+        break;
+
+    case DropOldest:
+        for (int i = 0; i < due - 1; ++i)
+            popFront();
+        m_dropped += quint64(due - 1);
+        copyFrame(m_display, at(0).frame);
+        popFront();
+        break;
+
+    case Coalesce:
+        copyFrame(m_display, at(0).frame);
+        popFront();
+        for (int i = 1; i < due; ++i) {
+            const LedFrame &frame = at(0).frame;
+            if (frame.colored && m_display.colored) {
+                mergeColors(m_display, frame);
+                m_display.active.orWith(frame.active);
+            } else if (frame.colored || m_display.colored) {
+                // Mixed frames cannot be merged, the newer one wins.
+                m_display.copyStateFrom(frame);
+            } else {
+                m_display.active.orWith(frame.active);
+            }
+            // Latency counts from the oldest frame shown, only the sequence
+            // is the newest one's.
+            m_display.sequence = frame.sequence;
+            popFront();
+        }
+        m_coalesced += quint64(due - 1);
+        break;
+    }
+
+    ++m_presented;
+    return &m_display;
+}
+
+qint64 FramePacer::nextDueIn(qint64 now) const
+{
+    if (m_count == 0)
+        return -1;
+    return qMax<qint64>(0, at(0).due - now);
+}
+
+void FramePacer::popFront()
+{
+    m_head = (m_head + 1) % m_entries.size();
+    --m_count;
+}
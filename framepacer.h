@@ -0,0 +1,91 @@
+// Copyright (C) 2016 The Qt Company Ltd.
+// SPDX-License-Identifier: LicenseRef-Qt-Commercial OR BSD-3-Clause
+
+#ifndef FRAMEPACER_H
+#define FRAMEPACER_H
+
+#include <QtGlobal>
+#include <QList>
+#include <QString>
+#include "frameparser.h"
+
+/*
+ * Jitter buffer between frame arrival and display. Every frame is held
+ * until its arrival time plus the playout delay, so the display cadence
+ * follows the sender instead of the network. When several frames are due
+ * at one display refresh the policy decides what is shown:
+ *   DropOldest  show the newest due frame, the older ones are dropped
+ *   Coalesce    show the union of all due frames, so short blinks survive
+ *   SlowDown    show one frame per refresh and let the backlog delay playback
+ * Timestamps are steady clock nanoseconds, see now().
+ */
+class FramePacer
+{
+public:
+    enum Policy {
+        DropOldest,
+        Coalesce,
+        SlowDown
+    };
+
+    explicit FramePacer(int ledCount, int capacity = 32);
+
+    static int defaultPlayoutDelay() { return m_defaultPlayoutDelay; }
+    static void setDefaultPlayoutDelay(int ms) { m_defaultPlayoutDelay = qMax(0, ms); }
+    static Policy defaultPolicy() { return m_defaultPolicy; }
+    static void setDefaultPolicy(Policy policy) { m_defaultPolicy = policy; }
+    static bool policyFromString(const QString &name, Policy *policy);
+
+    void setPlayoutDelay(qint64 ns) { m_playoutDelay = ns; }
+    void setPolicy(Policy policy) { m_policy = policy; }
+    void setRefreshInterval(qint64 ns) { m_refreshInterval = qMax<qint64>(1, ns); }
+
+    void push(const LedFrame &frame);
+    const LedFrame *frameForDisplay(qint64 now);
+    // Nanoseconds until the oldest queued frame is due, -1 when empty.
+    qint64 nextDueIn(qint64 now) const;
+    bool isEmpty() const { return m_count == 0; }
+
+    quint64 framesPresented() const { return m_presented; }
+    quint64 framesLate() const { return m_late; }
+    quint64 framesDropped() const { return m_dropped; }
+    quint64 framesCoalesced() const { return m_coalesced; }
+    // Refreshes that repeated a frame because the next arrived late, and
+    // frames repeating the sequence number before them.
+    quint64 framesDuplicated() const { return m_duplicated; }
+
+    static qint64 now();
+
+private:
+    struct Entry
+    {
+        LedFrame frame;
+        qint64 due = 0;
+    };
+
+    Entry &at(int i) { return m_entries[(m_head + i) % m_entries.size()]; }
+    const Entry &at(int i) const { return m_entries[(m_head + i) % m_entries.size()]; }
+    void popFront();
+
+    QList<Entry> m_entries;
+    int m_head = 0;
+    int m_count = 0;
+    LedFrame m_display;
+
+    qint64 m_playoutDelay;
+    qint64 m_refreshInterval = 16666667;
+    Policy m_policy;
+
+    quint64 m_presented = 0;
+    quint64 m_late = 0;
+    quint64 m_dropped = 0;
+    quint64 m_coalesced = 0;
+    quint64 m_duplicated = 0;
+    bool m_haveSequence = false;
+    quint16 m_lastSequence = 0;
+
+    static int m_defaultPlayoutDelay;
+    static Policy m_defaultPolicy;
+};
+
+#endif // FRAMEPACER_H
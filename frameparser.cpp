@@ -0,0 +1,457 @@
+// Copyright (C) 2016 The Qt Company Ltd.
+// SPDX-License-Identifier: LicenseRef-Qt-Commercial OR BSD-3-Clause
+
+#include "frameparser.h"
+#include <QtAlgorithms>
+#include <cstdio>
+#include <cstring>
+
+static const quint8 InvalidIndex = 0xFF;
+
+void LedFrame::resize(int ledCount)
+{
+    active.resize(ledCount);
+    colors.fill(0, ledCount);
+    colored = false;
+}
+
+void LedFrame::clear()
+{
+    active.clear();
+    if (colored)
+        memset(colors.data(), 0, colors.size() * sizeof(quint32));
+    colored = false;
+}
+
+void LedFrame::copyStateFrom(const LedFrame &other)
+{
+    active.copyFrom(other.active);
+    if (other.colored)
+        memcpy(colors.data(), other.colors.constData(), colors.size() * sizeof(quint32));
+    else if (colored)
+        memset(colors.data(), 0, colors.size() * sizeof(quint32));
+    colored = other.colored;
+}
+
+int LedFrame::packColors(uchar *bytes) const
+{
+    // Walks the set bits a word at a time.
+    const quint64 *words = active.constData();
+    uchar *out = bytes;
+    for (int w = 0; w < active.wordCount(); ++w) {
+        for (quint64 bits = words[w]; bits; bits &= bits - 1) {
+            const int led = w * 64 + qCountTrailingZeroBits(bits);
+            memcpy(out, colors.constData() + led, sizeof(quint32));
+            out += sizeof(quint32);
+        }
+    }
+    return int(out - bytes);
+}
+
+void LedFrame::unpackColors(const uchar *bytes)
+{
+    const quint64 *words = active.constData();
+    for (int w = 0; w < active.wordCount(); ++w) {
+        for (quint64 bits = words[w]; bits; bits &= bits - 1) {
+            const int led = w * 64 + qCountTrailingZeroBits(bits);
+            memcpy(colors.data() + led, bytes, sizeof(quint32));
+            bytes += sizeof(quint32);
+        }
+    }
+    colored = true;
+}
+
+FrameParser::FrameParser(const CubeConfig &config)
+    : m_config(config)
+    , m_binaryPayloadSize((config.ledCount() + 7) / 8)
+{
+    memset(m_pinIndex, InvalidIndex, sizeof(m_pinIndex));
+    for (int i = 0; i < m_config.xPins.size(); ++i)
+        m_pinIndex[0][m_config.xPins.at(i)] = quint8(i);
+    for (int i = 0; i < m_config.yPins.size(); ++i)
+        m_pinIndex[1][m_config.yPins.at(i)] = quint8(i);
+    for (int i = 0; i < m_config.zPins.size(); ++i)
+        m_pinIndex[2][m_config.zPins.at(i)] = quint8(i);
+
+    m_frame.resize(m_config.ledCount());
+    m_colorBytes.resize(m_config.ledCount() * int(sizeof(quint32)));
+}
+
+void FrameParser::reset()
+{
+    m_state = ExpectToken;
+    m_axisMask = 0;
+    m_dashes = 0;
+    m_haveSequence = false;
+    m_frame.clear();
+    m_frame.sequence = 0;
+    m_frame.sequenced = false;
+    m_frame.binary = false;
+}
+
+int FrameParser::feed(const char *data, qsizetype size)
+{
+    int frames = 0;
+
+    for (qsizetype i = 0; i < size; ++i)
+    {
+        const char c = data[i];
+
+        switch (m_state)
+        {
+        case ExpectToken:
+            if (quint8(c) == BINARY_SYNC_0)
+            {
+                m_state = BinarySync;
+            }
+            else if (c == 'X' || c == 'Y' || c == 'Z')
+            {
+                m_axis = c - 'X';
+                m_pin = 0;
+                m_digits = 0;
+                m_state = PinDigits;
+            }
+            else if (c == '#')
+            {
+                m_sequence = 0;
+                m_digits = 0;
+                m_state = SequenceDigits;
+            }
+            else if (c == '-')
+            {
+                m_dashes = 1;
+                m_state = Terminator;
+            }
+            else if (c != ':' && c != '\r' && c != '\n' && c != ' ')
+            {
+                ++m_tokensRejected;
+                m_axisMask = 0;
+                m_state = Resync;
+            }
+            break;
+
+        case PinDigits:
+            if (c >= '0' && c <= '9' && m_digits < 3)
+            {
+                m_pin = m_pin * 10 + unsigned(c - '0');
+                ++m_digits;
+            }
+            else if (c == ':' && m_digits > 0)
+            {
+                finishToken();
+                m_state = ExpectToken;
+            }
+            else if (c == '-' && m_digits > 0)
+            {
+                finishToken();
+                m_dashes = 1;
+                m_state = Terminator;
+            }
+            else
+            {
+                ++m_tokensRejected;
+                m_axisMask = 0;
+                m_state = Resync;
+            }
+            break;
+
+        case SequenceDigits:
+            if (c >= '0' && c <= '9' && m_digits < 5)
+            {
+                m_sequence = m_sequence * 10 + unsigned(c - '0');
+                ++m_digits;
+            }
+            else if (c == ':' && m_digits > 0)
+            {
+                // Out of range is rejected, not wrapped; the frame goes
+                // without a sequence number.
+                if (m_sequence <= 0xFFFF)
+                {
+                    m_frame.sequence = quint16(m_sequence);
+                    m_frame.sequenced = true;
+                }
+                else
+                {
+                    ++m_tokensRejected;
+                }
+                m_state = ExpectToken;
+            }
+            else
+            {
+                ++m_tokensRejected;
+                m_state = Resync;
+            }
+            break;
+
+        case Terminator:
+            if (c == '-' && m_dashes < 4)
+            {
+                ++m_dashes;
+            }
+            else if (c == '\r' && m_dashes == 4)
+            {
+                m_state = TerminatorLf;
+            }
+            else if (c == '\n' && m_dashes == 4)
+            {
+                finishFrame();
+                ++frames;
+            }
+            else
+            {
+                ++m_tokensRejected;
+                m_state = Resync;
+            }
+            break;
+
+        case TerminatorLf:
+            if (c == '\n')
+            {
+                finishFrame();
+                ++frames;
+            }
+            else
+            {
+                ++m_tokensRejected;
+                m_state = Resync;
+            }
+            break;
+
+        case BinarySync:
+            if (quint8(c) == BINARY_SYNC_1)
+            {
+                m_header[0] = BINARY_SYNC_0;
+                m_header[1] = BINARY_SYNC_1;
+                m_headerSize = 2;
+                m_state = BinaryHeader;
+            }
+            else
+            {
+                ++m_tokensRejected;
+                m_state = Resync;
+            }
+            break;
+
+        case BinaryHeader:
+            m_header[m_headerSize++] = quint8(c);
+            if (m_headerSize == BINARY_HEADER_SIZE)
+                finishHeader();
+            break;
+
+        case BinaryPayload:
+        {
+            const qsizetype used = feedBinary(data + i, size - i);
+            i += used - 1;
+            if (m_payloadPos == m_payloadSize)
+            {
+                finishPayload();
+                if (m_state == ExpectToken && m_payloadValid)
+                    ++frames;
+            }
+            break;
+        }
+
+        case BinaryColors:
+        {
+            const qsizetype used = feedColors(data + i, size - i);
+            i += used - 1;
+            if (m_colorPos == m_colorSize)
+            {
+                m_frame.unpackColors(reinterpret_cast<const uchar *>(m_colorBytes.constData()));
+                ++m_binaryFrames;
+                finishFrame();
+                ++frames;
+            }
+            break;
+        }
+
+        case BinaryHunt:
+            // Slide an eight byte window over the stream until it holds a
+            // header this parser can decode.
+            m_header[m_headerSize++] = quint8(c);
+            if (m_headerSize == 1 && m_header[0] != BINARY_SYNC_0)
+            {
+                m_headerSize = 0;
+            }
+            else if (m_headerSize == BINARY_HEADER_SIZE)
+            {
+                if (isPlausibleHeader())
+                {
+                    finishHeader();
+                }
+                else
+                {
+                    memmove(m_header, m_header + 1, BINARY_HEADER_SIZE - 1);
+                    m_headerSize = BINARY_HEADER_SIZE - 1;
+                }
+            }
+            break;
+
+        case Resync:
+            // Skip the damaged token, the next separator starts a fresh one.
+            if (quint8(c) == BINARY_SYNC_0)
+            {
+                m_state = BinarySync;
+            }
+            else if (c == ':' || c == '\n')
+            {
+                m_state = ExpectToken;
+            }
+            else if (c == '-')
+            {
+                m_dashes = 1;
+                m_state = Terminator;
+            }
+            break;
+        }
+    }
+
+    return frames;
+}
+
+void FrameParser::finishHeader()
+{
+    const int version = m_header[2];
+    const quint16 sequence = quint16(m_header[4] | (m_header[5] << 8));
+    m_payloadSize = m_header[6] | (m_header[7] << 8);
+    m_payloadPos = 0;
+
+    if (m_payloadSize == 0 || m_payloadSize > BINARY_MAX_PAYLOAD)
+    {
+        // Length is garbage, hunt for the next sync instead of trusting it.
+        ++m_tokensRejected;
+        m_state = Resync;
+        return;
+    }
+
+    // A frame we cannot decode is still skipped by its length so the stream
+    // stays aligned.
+    m_payloadValid = version == BINARY_VERSION && m_payloadSize == m_binaryPayloadSize;
+    m_payloadColored = m_header[3] & BINARY_FLAG_COLOR;
+    if (!m_payloadValid)
+        ++m_tokensRejected;
+
+    m_frame.clear();
+    m_frame.sequence = sequence;
+    m_frame.sequenced = true;
+    m_frame.binary = true;
+    m_state = BinaryPayload;
+}
+
+bool FrameParser::isPlausibleHeader() const
+{
+    const int payloadSize = m_header[6] | (m_header[7] << 8);
+    return m_header[0] == BINARY_SYNC_0 && m_header[1] == BINARY_SYNC_1
+            && m_header[2] == BINARY_VERSION && (m_header[3] & ~BINARY_FLAG_COLOR) == 0
+            && payloadSize == m_binaryPayloadSize;
+}
+
+qsizetype FrameParser::feedBinary(const char *data, qsizetype size)
+{
+    const qsizetype n = qMin(size, qsizetype(m_payloadSize - m_payloadPos));
+    if (m_payloadValid)
+        m_frame.active.setBytes(m_payloadPos, reinterpret_cast<const uchar *>(data), int(n));
+    m_payloadPos += int(n);
+    return n;
+}
+
+qsizetype FrameParser::feedColors(const char *data, qsizetype size)
+{
+    const qsizetype n = qMin(size, qsizetype(m_colorSize - m_colorPos));
+    memcpy(m_colorBytes.data() + m_colorPos, data, size_t(n));
+    m_colorPos += int(n);
+    return n;
+}
+
+void FrameParser::finishPayload()
+{
+    if (!m_payloadValid)
+    {
+        // The color section of a frame we could not decode has no known
+        // length and may hold any byte, only a complete decodable header
+        // ends it. The frame still arrived, a sender waiting for its ack
+        // must not stall.
+        trackSequence(m_frame.sequence);
+        if (m_skipHandler)
+            m_skipHandler(m_frame.sequence);
+        m_frame.clear();
+        m_frame.sequenced = false;
+        m_frame.binary = false;
+        m_headerSize = 0;
+        m_state = m_payloadColored ? BinaryHunt : ExpectToken;
+        return;
+    }
+
+    m_colorSize = m_payloadColored ? m_frame.active.count() * int(sizeof(quint32)) : 0;
+    m_colorPos = 0;
+    if (m_colorSize > 0)
+    {
+        m_state = BinaryColors;
+        return;
+    }
+    if (m_payloadColored)
+        m_frame.colored = true;
+    ++m_binaryFrames;
+    finishFrame();
+}
+
+void FrameParser::finishToken()
+{
+    // An X token starts a triple. Y and Z tokens without one, the rest of
+    // a triple whose X or Y was rejected, are dropped.
+    if (m_axis == 0)
+        m_axisMask = 0;
+    else if (!(m_axisMask & 1U))
+        return;
+
+    const quint8 index = m_pin < MAX_PIN_NUMBER ? m_pinIndex[m_axis][m_pin] : InvalidIndex;
+    if (index == InvalidIndex)
+    {
+        ++m_tokensRejected;
+        m_axisMask = 0;
+        return;
+    }
+
+    m_coords[m_axis] = index;
+    m_axisMask |= 1U << m_axis;
+    if (m_axisMask == 7U)
+    {
+        m_frame.active.set(m_config.index(m_coords[0], m_coords[1], m_coords[2]));
+        m_axisMask = 0;
+    }
+}
+
+void FrameParser::finishFrame()
+{
+    ++m_framesParsed;
+    if (m_frame.sequenced)
+        trackSequence(m_frame.sequence);
+
+    if (m_handler)
+        m_handler(m_frame);
+
+    m_frame.clear();
+    m_frame.sequence = 0;
+    m_frame.sequenced = false;
+    m_frame.binary = false;
+    m_axisMask = 0;
+    m_state = ExpectToken;
+}
+
+void FrameParser::trackSequence(quint16 sequence)
+{
+    if (m_haveSequence && sequence != quint16(m_lastSequence + 1))
+        ++m_sequenceGaps;
+    m_lastSequence = sequence;
+    m_haveSequence = true;
+}
+
+int FrameParser::formatWindowRequest(char *buffer, int size, int window)
+{
+    return snprintf(buffer, size_t(size), "W%d\r\n", window);
+}
+
+int FrameParser::formatAck(char *buffer, int size, quint16 sequence)
+{
+    return snprintf(buffer, size_t(size), "A%u\r\n", unsigned(sequence));
+}
@@ -0,0 +1,162 @@
+// Copyright (C) 2016 The Qt Company Ltd.
+// SPDX-License-Identifier: LicenseRef-Qt-Commercial OR BSD-3-Clause
+
+#ifndef FRAMEPARSER_H
+#define FRAMEPARSER_H
+
+#include <QtGlobal>
+#include <QList>
+#include <QByteArray>
+#include <functional>
+#include <cstring>
+#include "cubeconfig.h"
+#include "voxelgrid.h"
+
+/*
+ * Binary frame layout (all fields little endian):
+ *   0  u8   0xA5 sync
+ *   1  u8   0x5A sync
+ *   2  u8   protocol version
+ *   3  u8   flags, bit 0 color
+ *   4  u16  sequence number
+ *   6  u16  payload length in bytes
+ *   8  ...  bitmask, bit n is LED n = (x * sizeY + y) * sizeZ + z
+ * With the color flag the bitmask is followed by four bytes, red, green,
+ * blue and intensity, for every lit LED in index order. The length of the
+ * color section follows from the bitmask and is not part of the payload
+ * length.
+ */
+#define BINARY_SYNC_0 0xA5
+#define BINARY_SYNC_1 0x5A
+#define BINARY_VERSION 1
+#define BINARY_FLAG_COLOR 0x01
+#define BINARY_HEADER_SIZE 8
+#define BINARY_MAX_PAYLOAD ((MAX_CUBE_SIZE * MAX_CUBE_SIZE * MAX_CUBE_SIZE + 7) / 8)
+
+// One LED color, the bytes red, green, blue and intensity in memory order.
+inline quint32 ledColor(quint8 red, quint8 green, quint8 blue, quint8 intensity)
+{
+    const quint8 bytes[4] = { red, green, blue, intensity };
+    quint32 color;
+    memcpy(&color, bytes, sizeof(color));
+    return color;
+}
+
+struct LedFrame
+{
+    VoxelGrid active;
+    // One ledColor() per LED, zero for the unlit ones. Only filled in when
+    // the frame is colored, plain frames are lit or not.
+    QList<quint32> colors;
+    bool colored = false;
+    quint16 sequence = 0;
+    bool sequenced = false;
+    bool binary = false;
+    qint64 timestamp = 0;   // arrival, steady clock nanoseconds
+    qint64 received = 0;    // first byte read from the socket, same clock
+
+    void resize(int ledCount);
+    void clear();
+    void copyStateFrom(const LedFrame &other);
+    // Colors of the lit LEDs in index order, as in binary frames.
+    int packColors(uchar *bytes) const;
+    void unpackColors(const uchar *bytes);
+};
+
+/*
+ * Incremental parser for the "Xnn:Ynn:Znn:...:----\r\n" LED frame protocol
+ * and its bit-packed binary counterpart. Bytes can be fed in arbitrary chunks:
+ * partial tokens are kept between calls and every terminator found in a chunk
+ * completes one frame. Both formats are recognised at every frame boundary so
+ * firmware that ignores the binary request keeps working. Text frames may
+ * carry a sequence number as a leading "#nnn:" token. A colored binary
+ * frame that cannot be decoded has a color section of unknown length, the
+ * parser then only resumes at a complete header it can decode. The parser
+ * never allocates while feeding.
+ */
+class FrameParser
+{
+public:
+    using FrameHandler = std::function<void(const LedFrame &frame)>;
+    // Binary frames that could not be decoded, by sequence number.
+    using SkipHandler = std::function<void(quint16 sequence)>;
+
+    explicit FrameParser(const CubeConfig &config = CubeConfig::current());
+
+    void setFrameHandler(FrameHandler handler) { m_handler = std::move(handler); }
+    void setSkipHandler(SkipHandler handler) { m_skipHandler = std::move(handler); }
+    int feed(const char *data, qsizetype size);
+    void reset();
+
+    quint64 framesParsed() const { return m_framesParsed; }
+    quint64 tokensRejected() const { return m_tokensRejected; }
+    quint64 binaryFrames() const { return m_binaryFrames; }
+    quint64 sequenceGaps() const { return m_sequenceGaps; }
+
+    static const char *binaryRequest() { return "B\r\n"; }
+    static const char *stopAndWaitAck() { return "S\r\n"; }
+    // "Wn\r\n" grants a window of n unacknowledged frames, "An\r\n"
+    // acknowledges every frame up to and including sequence n.
+    static int formatWindowRequest(char *buffer, int size, int window);
+    static int formatAck(char *buffer, int size, quint16 sequence);
+
+private:
+    enum State {
+        ExpectToken,
+        PinDigits,
+        SequenceDigits,
+        Terminator,
+        TerminatorLf,
+        BinarySync,
+        BinaryHeader,
+        BinaryPayload,
+        BinaryColors,
+        BinaryHunt,
+        Resync
+    };
+
+    qsizetype feedBinary(const char *data, qsizetype size);
+    qsizetype feedColors(const char *data, qsizetype size);
+    void finishPayload();
+    void finishHeader();
+    bool isPlausibleHeader() const;
+    void finishToken();
+    void finishFrame();
+    void trackSequence(quint16 sequence);
+
+    CubeConfig m_config;
+    int m_binaryPayloadSize = 0;
+
+    State m_state = ExpectToken;
+    int m_axis = 0;
+    unsigned int m_pin = 0;
+    unsigned int m_sequence = 0;
+    int m_digits = 0;
+    int m_dashes = 0;
+    int m_coords[3] = {0, 0, 0};
+    unsigned int m_axisMask = 0;
+
+    quint8 m_header[BINARY_HEADER_SIZE];
+    int m_headerSize = 0;
+    int m_payloadSize = 0;
+    int m_payloadPos = 0;
+    bool m_payloadValid = false;
+    bool m_payloadColored = false;
+    QByteArray m_colorBytes;
+    int m_colorSize = 0;
+    int m_colorPos = 0;
+    bool m_haveSequence = false;
+    quint16 m_lastSequence = 0;
+
+    quint8 m_pinIndex[3][MAX_PIN_NUMBER];
+    LedFrame m_frame;
+    FrameHandler m_handler;
+    SkipHandler m_skipHandler;
+
+    quint64 m_framesParsed = 0;
+    quint64 m_tokensRejected = 0;
+    quint64 m_binaryFrames = 0;
+    quint64 m_sequenceGaps = 0;
+};
+
+#endif // FRAMEPARSER_H
@@ -0,0 +1,416 @@
+// Copyright (C) 2016 The Qt Company Ltd.
+// SPDX-License-Identifier: LicenseRef-Qt-Commercial OR BSD-3-Clause
+
+#include "framereceiver.h"
+#include <QTcpSocket>
+#include <QTimer>
+#include <QDeadlineTimer>
+#include <QRandomGenerator>
+#include <QDebug>
+
+bool FrameReceiver::m_binaryProtocol = true;
+QString FrameReceiver::m_hostName = QStringLiteral("192.168.0.24");
+quint16 FrameReceiver::m_port = 1234;
+int FrameReceiver::m_windowSize = 1;
+QString FrameReceiver::m_recordFile;
+QString FrameReceiver::m_replayFile;
+double FrameReceiver::m_replaySpeed = 1.0;
+QString FrameReceiver::m_demoPattern;
+double FrameReceiver::m_demoRate = 30.0;
+
+static const int ConnectTimeout = 3000;
+static const int MinReconnectDelay = 250;
+static const int MaxReconnectDelay = 30000;
+// Frames replayed back to back before yielding to the event loop.
+static const int ReplayBatch = 256;
+
+// Timer interval for a wait in ns, rounded up: a 0 ms timer for a frame
+// due within the millisecond would spin. Frames due by then go out in one
+// batch.
+static int timerInterval(qint64 ns)
+{
+    return int((ns + 999999) / 1000000);
+}
+
+FrameReceiver::FrameReceiver(const CubeConfig &config)
+    : m_config(config)
+    , m_deviceHost(m_hostName)
+    , m_devicePort(m_port)
+    , m_parser(config)
+{
+    m_frames.initialize([&config](LedFrame &frame) {
+        frame.resize(config.ledCount());
+    });
+    m_replayFrame.resize(config.ledCount());
+
+    m_parser.setFrameHandler([this](const LedFrame &frame) {
+        publish(frame);
+        acknowledge(frame.sequenced, frame.sequence);
+    });
+    // A binary frame that could not be decoded is acknowledged all the same,
+    // the device does not resend and would otherwise wait for it forever.
+    m_parser.setSkipHandler([this](quint16 sequence) {
+        acknowledge(true, sequence);
+    });
+}
+
+FrameReceiver::~FrameReceiver()
+{
+    stop();
+    delete m_demo;
+}
+
+void FrameReceiver::start()
+{
+    m_stopping = false;
+    if (!m_recordFile.isEmpty())
+        m_recorder.open(m_recordFile, m_config);
+
+    if (!m_demoPattern.isEmpty()) {
+        startDemo();
+        return;
+    }
+
+    if (!m_replayFile.isEmpty()) {
+        startReplay();
+        return;
+    }
+
+    // Created here rather than in the constructor so the socket and timers
+    // belong to the thread this object was moved to.
+    socket = new QTcpSocket(this);
+    m_reconnectTimer = new QTimer(this);
+    m_reconnectTimer->setSingleShot(true);
+    m_connectTimer = new QTimer(this);
+    m_connectTimer->setSingleShot(true);
+
+    //Connect signal to this receiver
+    connect(socket, &QTcpSocket::connected, this, &FrameReceiver::connected);
+    //Disconnect signal to this receiver
+    connect(socket, &QTcpSocket::disconnected, this, &FrameReceiver::disconnected);
+    //readRead signal to this receiver
+    connect(socket, &QTcpSocket::readyRead, this, &FrameReceiver::readyRead);
+    //bytesWritten signal to this receiver
+    connect(socket, &QTcpSocket::bytesWritten, this, &FrameReceiver::bytesWritten);
+    connect(socket, &QTcpSocket::errorOccurred, this, &FrameReceiver::errorOccurred);
+    connect(m_reconnectTimer, &QTimer::timeout, this, &FrameReceiver::connectToDevice);
+    connect(m_connectTimer, &QTimer::timeout, this, &FrameReceiver::connectTimedOut);
+
+    connectToDevice();
+}
+
+void FrameReceiver::stop()
+{
+    m_stopping = true;
+    m_recorder.close();
+    if (m_replayTimer)
+        m_replayTimer->stop();
+    if (m_demoTimer)
+        m_demoTimer->stop();
+    m_replay.close();
+
+    if (!socket)
+        return;
+
+    // Never wait for the peer here, this runs while the owning window is
+    // being torn down.
+    m_reconnectTimer->stop();
+    m_connectTimer->stop();
+    socket->disconnectFromHost();
+    if (socket->state() != QAbstractSocket::UnconnectedState)
+        socket->abort();
+    delete socket;
+    socket = nullptr;
+    setConnectionState(Disconnected);
+}
+
+void FrameReceiver::startReplay()
+{
+    QString error;
+    if (!m_replay.open(m_replayFile, m_config, &error)) {
+        qWarning() << "Cannot replay" << error;
+        setConnectionState(Disconnected);
+        return;
+    }
+
+    qDebug() << "Replaying" << m_replay.frameCount() << "frames from" << m_replayFile;
+    m_replayTimer = new QTimer(this);
+    m_replayTimer->setSingleShot(true);
+    m_replayTimer->setTimerType(Qt::PreciseTimer);
+    connect(m_replayTimer, &QTimer::timeout, this, &FrameReceiver::replayNext);
+
+    m_replayPosition = 0;
+    m_replayStart = QDeadlineTimer::current(Qt::PreciseTimer).deadlineNSecs();
+    m_waitForConsumer = true;
+    setConnectionState(Connected);
+    replayNext();
+}
+
+void FrameReceiver::startDemo()
+{
+    PatternEngine::Pattern pattern;
+    if (!PatternEngine::patternFromString(m_demoPattern, &pattern)) {
+        qWarning() << "Unknown demo pattern" << m_demoPattern;
+        setConnectionState(Disconnected);
+        return;
+    }
+
+    // Every receiver of a pool gets its own seed.
+    delete m_demo;
+    m_demo = new PatternEngine(pattern, m_config, QRandomGenerator::global()->generate());
+    m_demoFrame.resize(m_config.ledCount());
+    m_demoTimer = new QTimer(this);
+    m_demoTimer->setSingleShot(true);
+    m_demoTimer->setTimerType(Qt::PreciseTimer);
+    connect(m_demoTimer, &QTimer::timeout, this, &FrameReceiver::demoNext);
+
+    m_demoStart = QDeadlineTimer::current(Qt::PreciseTimer).deadlineNSecs();
+    m_waitForConsumer = m_demoRate <= 0;
+    setConnectionState(Connected);
+    demoNext();
+}
+
+void FrameReceiver::demoNext()
+{
+    for (int batch = 0; batch < ReplayBatch; ++batch) {
+        if (m_stopping)
+            return;
+
+        const qint64 now = QDeadlineTimer::current(Qt::PreciseTimer).deadlineNSecs();
+        if (m_demoRate > 0) {
+            const qint64 due = m_demoStart + qint64(m_demo->step() * 1e9 / m_demoRate);
+            if (due > now) {
+                m_demoTimer->start(timerInterval(due - now));
+                return;
+            }
+        }
+
+        // Generating the frame counts as receiving and parsing it.
+        m_frameReceived = now;
+        m_demo->next(&m_demoFrame.active);
+        m_demoFrame.sequence = quint16(m_demo->step());
+        if (!publish(m_demoFrame) && m_waitForConsumer) {
+            m_demoTimer->start(1);
+            return;
+        }
+    }
+    m_demoTimer->start(0);
+}
+
+void FrameReceiver::replayNext()
+{
+    for (int batch = 0; batch < ReplayBatch; ++batch) {
+        if (m_stopping)
+            return;
+
+        if (m_replayPosition >= m_replay.frameCount()) {
+            qDebug() << "Replay finished";
+            setConnectionState(Disconnected);
+            emit replayFinished();
+            return;
+        }
+
+        if (m_replaySpeed > 0) {
+            const qint64 due = m_replayStart
+                    + qint64(m_replay.timestampAt(m_replayPosition) / m_replaySpeed);
+            const qint64 wait = due - QDeadlineTimer::current(Qt::PreciseTimer).deadlineNSecs();
+            if (wait > 0) {
+                m_replayTimer->start(timerInterval(wait));
+                return;
+            }
+        }
+
+        m_replay.readFrame(m_replayPosition, &m_replayFrame);
+        // A full ring means the consumer is behind, wait for it instead of
+        // dropping recorded frames.
+        if (!publish(m_replayFrame)) {
+            m_replayTimer->start(1);
+            return;
+        }
+        ++m_replayPosition;
+    }
+    m_replayTimer->start(0);
+}
+
+void FrameReceiver::connectToDevice()
+{
+    if (m_stopping)
+        return;
+
+    qDebug() << "Connecting to" << m_deviceHost << m_devicePort;
+    m_parser.reset();
+    m_frameReceived = -1;
+    m_ackPending = false;
+    m_unackedFrames = 0;
+    setConnectionState(Connecting);
+    socket->connectToHost(m_deviceHost, m_devicePort);
+    m_connectTimer->start(ConnectTimeout);
+}
+
+void FrameReceiver::connectTimedOut()
+{
+    qDebug() << "Connection to" << m_deviceHost << m_devicePort << "timed out";
+    // abort() does not emit errorOccurred(), schedule the retry ourselves.
+    socket->abort();
+    scheduleReconnect();
+}
+
+void FrameReceiver::scheduleReconnect()
+{
+    if (m_stopping || m_reconnectTimer->isActive())
+        return;
+
+    m_connectTimer->stop();
+    m_reconnectDelay = m_reconnectDelay
+            ? qMin(m_reconnectDelay * 2, MaxReconnectDelay)
+            : MinReconnectDelay;
+    setConnectionState(WaitingToReconnect);
+    m_reconnectTimer->start(m_reconnectDelay);
+}
+
+void FrameReceiver::setConnectionState(ConnectionState state)
+{
+    if (state == m_connectionState)
+        return;
+
+    m_connectionState = state;
+    emit connectionStateChanged(state);
+}
+
+const LedFrame *FrameReceiver::acquireLatestFrame()
+{
+    // Clear first: a frame published after this point raises a new signal.
+    m_notifyPending.store(false, std::memory_order_release);
+    return m_frames.acquireLatest();
+}
+
+const LedFrame *FrameReceiver::acquireNextFrame()
+{
+    m_notifyPending.store(false, std::memory_order_release);
+    return m_frames.acquireNext();
+}
+
+void FrameReceiver::connected()
+{
+    qDebug() << "Connected in frame receiver";
+    m_connectTimer->stop();
+    m_reconnectDelay = 0;
+    setConnectionState(Connected);
+
+    // Ask for bit-packed frames. Older firmware ignores the request and keeps
+    // sending text frames, which the parser still accepts.
+    if (m_binaryProtocol)
+        socket->write(FrameParser::binaryRequest());
+
+    if (m_windowSize > 1) {
+        char request[16];
+        const int n = FrameParser::formatWindowRequest(request, sizeof(request), m_windowSize);
+        socket->write(request, n);
+    }
+}
+
+void FrameReceiver::disconnected()
+{
+    qDebug() << "Disconnected in frame receiver";
+    scheduleReconnect();
+}
+
+void FrameReceiver::errorOccurred(QAbstractSocket::SocketError error)
+{
+    qDebug() << "Socket error: " << error;
+    if (socket->state() != QAbstractSocket::ConnectedState)
+        scheduleReconnect();
+}
+
+void FrameReceiver::readyRead()
+{
+    // A frame starts with the first read after the previous one completed,
+    // further frames completed by this read arrived with it.
+    m_readAt = QDeadlineTimer::current(Qt::PreciseTimer).deadlineNSecs();
+    if (m_frameReceived < 0)
+        m_frameReceived = m_readAt;
+
+    // Drain the socket through a fixed buffer, the parser keeps any partial
+    // token and may complete several frames out of a single read.
+    qint64 n;
+    int frames = 0;
+    while ((n = socket->read(m_readBuffer, sizeof(m_readBuffer))) > 0)
+        frames += m_parser.feed(m_readBuffer, n);
+    m_readAt = -1;
+    if (frames > 0)
+        m_frameReceived = -1;
+
+    // One cumulative ack for everything this read completed.
+    flushAck();
+}
+
+void FrameReceiver::bytesWritten(qint64 bytes)
+{
+    Q_UNUSED(bytes);
+    // The write queue drained, release an ack held back by flushAck().
+    flushAck();
+}
+
+void FrameReceiver::acknowledge(bool sequenced, quint16 sequence)
+{
+    if (m_windowSize <= 1 || !sequenced) {
+        socket->write(FrameParser::stopAndWaitAck());
+        return;
+    }
+
+    m_ackSequence = sequence;
+    m_ackPending = true;
+    // Do not let the device run out of credit while a large read is parsed.
+    if (++m_unackedFrames >= qMax(1, m_windowSize / 2))
+        flushAck();
+}
+
+void FrameReceiver::flushAck()
+{
+    // Held back while the previous ack is still queued, one cumulative ack
+    // then covers everything received in between once bytesWritten() says
+    // the socket drained.
+    if (!m_ackPending || socket->bytesToWrite() > 0)
+        return;
+
+    char ack[16];
+    const int n = FrameParser::formatAck(ack, sizeof(ack), m_ackSequence);
+    socket->write(ack, n);
+    m_ackPending = false;
+    m_unackedFrames = 0;
+}
+
+bool FrameReceiver::publish(const LedFrame &frame)
+{
+    LedFrame *slot = m_frames.beginWrite();
+    // Offered again later, recorded then.
+    if (!slot && m_waitForConsumer)
+        return false;
+
+    const qint64 timestamp = QDeadlineTimer::current(Qt::PreciseTimer).deadlineNSecs();
+    // The recording keeps every decoded frame, also those the ring drops.
+    if (m_recorder.isOpen())
+        m_recorder.write(frame, timestamp);
+    if (!slot) {
+        m_framesDropped.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+
+    slot->copyStateFrom(frame);
+    slot->sequence = frame.sequence;
+    slot->sequenced = frame.sequenced;
+    slot->binary = frame.binary;
+    slot->timestamp = timestamp;
+    if (m_frameReceived >= 0) {
+        slot->received = m_frameReceived;
+        PipelineStats::instance().record(PipelineStats::ReceiveToParse, slot->timestamp - slot->received);
+        m_frameReceived = m_readAt;
+    } else {
+        slot->received = slot->timestamp;
+    }
+    m_frames.commitWrite();
+
+    if (!m_notifyPending.exchange(true, std::memory_order_acq_rel))
+        emit frameAvailable();
+    return true;
+}
@@ -0,0 +1,160 @@
+// Copyright (C) 2016 The Qt Company Ltd.
+// SPDX-License-Identifier: LicenseRef-Qt-Commercial OR BSD-3-Clause
+
+#ifndef FRAMERECEIVER_H
+#define FRAMERECEIVER_H
+
+#include <QObject>
+#include <QAbstractSocket>
+#include <QString>
+#include <atomic>
+#include "frameparser.h"
+#include "spscring.h"
+#include "sessionfile.h"
+#include "pipelinestats.h"
+#include "patternengine.h"
+
+QT_FORWARD_DECLARE_CLASS(QTcpSocket)
+QT_FORWARD_DECLARE_CLASS(QTimer)
+
+/*
+ * Owns the device socket and the frame parser. Meant to live in its own
+ * thread: decoded frames are published through a lock-free ring and
+ * frameAvailable() is emitted once per batch, so the GUI thread only ever
+ * touches the newest complete frame. Connecting never blocks: a lost or
+ * missing device is retried with exponential backoff.
+ *
+ * With a window size above one the device may keep that many sequenced
+ * frames in flight and is acknowledged cumulatively. Frames without a
+ * sequence number mean old firmware and fall back to stop-and-wait.
+ *
+ * Instead of a device the frames can come from a recorded session, replayed
+ * at its original pace, N times faster or as fast as the consumer keeps up.
+ * Every frame published can also be recorded. The built-in pattern engine
+ * is a third source, generating frames at a fixed rate or as fast as they
+ * are consumed, for demos and as a load source without any socket.
+ *
+ * The device defaults to the process wide endpoint, setDevice() points one
+ * receiver at another cube before it is started.
+ */
+class FrameReceiver : public QObject
+{
+    Q_OBJECT
+
+public:
+    enum ConnectionState {
+        Disconnected,
+        Connecting,
+        Connected,
+        WaitingToReconnect
+    };
+    Q_ENUM(ConnectionState)
+
+    explicit FrameReceiver(const CubeConfig &config = CubeConfig::current());
+    ~FrameReceiver();
+
+    static bool isBinaryProtocol() { return m_binaryProtocol; }
+    static void setBinaryProtocol(bool b) { m_binaryProtocol = b; }
+    static QString hostName() { return m_hostName; }
+    static quint16 port() { return m_port; }
+    static void setEndpoint(const QString &hostName, quint16 port) { m_hostName = hostName; m_port = port; }
+    static int windowSize() { return m_windowSize; }
+    static void setWindowSize(int frames) { m_windowSize = qMax(1, frames); }
+    static QString recordFile() { return m_recordFile; }
+    static void setRecordFile(const QString &fileName) { m_recordFile = fileName; }
+    static QString replayFile() { return m_replayFile; }
+    // A speed of 0 replays as fast as possible.
+    static void setReplayFile(const QString &fileName, double speed) { m_replayFile = fileName; m_replaySpeed = speed; }
+    static QString demoPattern() { return m_demoPattern; }
+    // A rate of 0 generates frames as fast as they are consumed.
+    static void setDemo(const QString &pattern, double rate) { m_demoPattern = pattern; m_demoRate = rate; }
+
+    void setDevice(const QString &hostName, quint16 port) { m_deviceHost = hostName; m_devicePort = port; }
+    QString deviceHost() const { return m_deviceHost; }
+    quint16 devicePort() const { return m_devicePort; }
+
+    ConnectionState connectionState() const { return m_connectionState; }
+
+    // Consumer side, to be called from the thread receiving frameAvailable().
+    const LedFrame *acquireLatestFrame();
+    const LedFrame *acquireNextFrame();
+    void releaseFrame() { m_frames.release(); }
+
+    quint64 framesDropped() const { return m_framesDropped.load(std::memory_order_relaxed); }
+
+public slots:
+    void start();
+    void stop();
+
+signals:
+    void frameAvailable();
+    void connectionStateChanged(FrameReceiver::ConnectionState state);
+    void replayFinished();
+
+private slots:
+    //Socket slots
+    void connected();
+    void disconnected();
+    void readyRead();
+    void bytesWritten(qint64 bytes);
+    void errorOccurred(QAbstractSocket::SocketError error);
+
+    void connectToDevice();
+    void connectTimedOut();
+    void replayNext();
+    void demoNext();
+
+private:
+    bool publish(const LedFrame &frame);
+    void startReplay();
+    void startDemo();
+    void acknowledge(bool sequenced, quint16 sequence);
+    void flushAck();
+    void scheduleReconnect();
+    void setConnectionState(ConnectionState state);
+
+    CubeConfig m_config;
+    QString m_deviceHost;
+    quint16 m_devicePort;
+    QTcpSocket *socket = nullptr;
+    QTimer *m_reconnectTimer = nullptr;
+    QTimer *m_connectTimer = nullptr;
+    int m_reconnectDelay = 0;
+    bool m_stopping = false;
+    bool m_ackPending = false;
+    quint16 m_ackSequence = 0;
+    int m_unackedFrames = 0;
+
+    SessionRecorder m_recorder;
+    SessionReplay m_replay;
+    LedFrame m_replayFrame;
+    QTimer *m_replayTimer = nullptr;
+    int m_replayPosition = 0;
+    qint64 m_replayStart = 0;
+    PatternEngine *m_demo = nullptr;
+    LedFrame m_demoFrame;
+    QTimer *m_demoTimer = nullptr;
+    qint64 m_demoStart = 0;
+    // Sources paced by the consumer wait for ring space instead of dropping.
+    bool m_waitForConsumer = false;
+    ConnectionState m_connectionState = Disconnected;
+    FrameParser m_parser;
+    SpscRing<LedFrame> m_frames { 16 };
+    char m_readBuffer[4096];
+    // When the next frame started to arrive, and the read being parsed.
+    qint64 m_frameReceived = -1;
+    qint64 m_readAt = -1;
+    std::atomic<bool> m_notifyPending { false };
+    std::atomic<quint64> m_framesDropped { 0 };
+    static bool m_binaryProtocol;
+    static QString m_hostName;
+    static quint16 m_port;
+    static int m_windowSize;
+    static QString m_recordFile;
+    static QString m_replayFile;
+    static double m_replaySpeed;
+    static QString m_demoPattern;
+    static double m_demoRate;
+};
+
+#endif // FRAMERECEIVER_H
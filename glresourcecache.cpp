@@ -0,0 +1,126 @@
+// Copyright (C) 2016 The Qt Company Ltd.
+// SPDX-License-Identifier: LicenseRef-Qt-Commercial OR BSD-3-Clause
+
+#include "glresourcecache.h"
+#include "logo.h"
+#include <QOpenGLContext>
+#include <QOpenGLShaderProgram>
+#include <QOpenGLTexture>
+
+GlResourceCache::GlResourceCache(QObject *parent)
+    : QObject(parent)
+{
+}
+
+GlResourceCache::~GlResourceCache()
+{
+    // The group is going away with its last context, the GL objects with it.
+    qDeleteAll(m_programs);
+    qDeleteAll(m_textures);
+}
+
+GlResourceCache *GlResourceCache::current()
+{
+    QOpenGLContext *context = QOpenGLContext::currentContext();
+    if (!context)
+        return nullptr;
+    GlResourceCache *cache = context->findChild<GlResourceCache *>(QString(), Qt::FindDirectChildrenOnly);
+    if (cache)
+        return cache;
+    QOpenGLContextGroup *group = context->shareGroup();
+    cache = group->findChild<GlResourceCache *>(QString(), Qt::FindDirectChildrenOnly);
+    if (!cache)
+        cache = new GlResourceCache(group);
+    return cache;
+}
+
+GlResourceCache *GlResourceCache::createPrivate()
+{
+    QOpenGLContext *context = QOpenGLContext::currentContext();
+    if (!context)
+        return nullptr;
+    GlResourceCache *cache = context->findChild<GlResourceCache *>(QString(), Qt::FindDirectChildrenOnly);
+    if (!cache)
+        cache = new GlResourceCache(context);
+    return cache;
+}
+
+void GlResourceCache::releasePrivate()
+{
+    QOpenGLContext *context = QOpenGLContext::currentContext();
+    if (context)
+        delete context->findChild<GlResourceCache *>(QString(), Qt::FindDirectChildrenOnly);
+}
+
+void GlResourceCache::insertProgram(const QByteArray &name, QOpenGLShaderProgram *program)
+{
+    delete m_programs.value(name);
+    m_programs.insert(name, program);
+}
+
+QOpenGLBuffer GlResourceCache::buffer(const void *owner, const QByteArray &name) const
+{
+    return m_buffers.value(Key(owner, name));
+}
+
+void GlResourceCache::insertBuffer(const void *owner, const QByteArray &name, const QOpenGLBuffer &buffer)
+{
+    m_buffers.insert(Key(owner, name), buffer);
+}
+
+QOpenGLTexture *GlResourceCache::texture(const void *owner, const QByteArray &name) const
+{
+    return m_textures.value(Key(owner, name));
+}
+
+void GlResourceCache::insertTexture(const void *owner, const QByteArray &name, QOpenGLTexture *texture)
+{
+    delete m_textures.value(Key(owner, name));
+    m_textures.insert(Key(owner, name), texture);
+}
+
+void GlResourceCache::release(const void *owner)
+{
+    // A buffer is destroyed with the last copy of it.
+    for (auto it = m_buffers.begin(); it != m_buffers.end(); ) {
+        if (it.key().first == owner)
+            it = m_buffers.erase(it);
+        else
+            ++it;
+    }
+    for (auto it = m_textures.begin(); it != m_textures.end(); ) {
+        if (it.key().first == owner) {
+            delete it.value();
+            it = m_textures.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
+QOpenGLBuffer GlResourceCache::meshVertexBuffer()
+{
+    QOpenGLBuffer vbo = buffer(nullptr, QByteArrayLiteral("mesh.vertices"));
+    if (!vbo.isCreated()) {
+        vbo.create();
+        vbo.bind();
+        vbo.allocate(Logo::meshVertices(), Logo::meshVertexCount() * sizeof(LedVertex));
+        vbo.release();
+        insertBuffer(nullptr, QByteArrayLiteral("mesh.vertices"), vbo);
+    }
+    return vbo;
+}
+
+QOpenGLBuffer GlResourceCache::meshIndexBuffer()
+{
+    QOpenGLBuffer ibo = buffer(nullptr, QByteArrayLiteral("mesh.indices"));
+    if (!ibo.isCreated()) {
+        ibo = QOpenGLBuffer(QOpenGLBuffer::IndexBuffer);
+        ibo.create();
+        ibo.bind();
+        ibo.allocate(Logo::meshIndices(), Logo::meshIndexCount() * sizeof(GLubyte));
+        ibo.release();
+        insertBuffer(nullptr, QByteArrayLiteral("mesh.indices"), ibo);
+    }
+    return ibo;
+}
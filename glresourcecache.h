@@ -0,0 +1,70 @@
+// Copyright (C) 2016 The Qt Company Ltd.
+// SPDX-License-Identifier: LicenseRef-Qt-Commercial OR BSD-3-Clause
+
+#ifndef GLRESOURCECACHE_H
+#define GLRESOURCECACHE_H
+
+#include <QObject>
+#include <QHash>
+#include <QOpenGLBuffer>
+
+QT_FORWARD_DECLARE_CLASS(QOpenGLShaderProgram)
+QT_FORWARD_DECLARE_CLASS(QOpenGLTexture)
+
+/*
+ * GPU objects kept for as long as the share group of the contexts they
+ * were made in. With Qt::AA_ShareOpenGLContexts every widget context joins
+ * the global share group, so programs, buffers and textures outlive the
+ * context a QOpenGLWidget loses when it is reparented, and a new window
+ * finds them ready. Without sharing the group, and the cache, ends with
+ * its only context.
+ *
+ * Programs and the LED mesh are shared by name. Buffers and textures
+ * holding one renderer's state are keyed by that renderer and released
+ * with it. Vertex array objects are not shareable and stay with the
+ * renderers.
+ *
+ * The cache is not locked. A context drawing on another thread than the
+ * rest of its group calls createPrivate() once current and then gets a
+ * cache of its own from current(): its programs, whose uniforms are set
+ * per draw, and buffers are never touched by two threads.
+ */
+class GlResourceCache : public QObject
+{
+    Q_OBJECT
+
+public:
+    // The cache of the current context's share group, made on first use.
+    static GlResourceCache *current();
+    // A cache for the current context alone, until releasePrivate(), which
+    // also wants the context current.
+    static GlResourceCache *createPrivate();
+    static void releasePrivate();
+
+    // Null until inserted. The cache takes ownership.
+    QOpenGLShaderProgram *program(const QByteArray &name) const { return m_programs.value(name); }
+    void insertProgram(const QByteArray &name, QOpenGLShaderProgram *program);
+
+    // Not created until inserted.
+    QOpenGLBuffer buffer(const void *owner, const QByteArray &name) const;
+    void insertBuffer(const void *owner, const QByteArray &name, const QOpenGLBuffer &buffer);
+    QOpenGLTexture *texture(const void *owner, const QByteArray &name) const;
+    void insertTexture(const void *owner, const QByteArray &name, QOpenGLTexture *texture);
+    // Frees everything the owner inserted.
+    void release(const void *owner);
+
+    // The unit cube every LED, brick and lattice box is drawn from.
+    QOpenGLBuffer meshVertexBuffer();
+    QOpenGLBuffer meshIndexBuffer();
+
+private:
+    explicit GlResourceCache(QObject *parent);
+    ~GlResourceCache();
+
+    typedef QPair<const void *, QByteArray> Key;
+    QHash<QByteArray, QOpenGLShaderProgram *> m_programs;
+    QHash<Key, QOpenGLBuffer> m_buffers;
+    QHash<Key, QOpenGLTexture *> m_textures;
+};
+
+#endif // GLRESOURCECACHE_H
@@ -3,16 +3,51 @@
 
 #include "glwidget.h"
 #include <QMouseEvent>
-#include <QOpenGLShaderProgram>
 #include <QCoreApplication>
+#include <QScreen>
 #include <QTextStream>
+#include <QPainter>
+#include <QFile>
+#include <QDir>
+#include <QJsonDocument>
+#include <QOpenGLTextureBlitter>
+#include <QtMath>
+#if !QT_CONFIG(opengles2)
+#include <QOpenGLTimerQuery>
+#endif
 #include <math.h>
 
 bool GLWidget::m_transparent = false;
+bool GLWidget::m_defaultStatsOverlay = false;
+QString GLWidget::m_statsFile = QStringLiteral("pipeline-stats.json");
+GLWidget::RenderMode GLWidget::m_defaultRenderMode = GLWidget::MeshRendering;
+bool GLWidget::m_threadedRendering = false;
+bool GLWidget::m_inertia = false;
+QString GLWidget::m_captureDirectory;
+int GLWidget::m_widgetCount = 0;
+FrameCapture::Format GLWidget::m_captureFormat = FrameCapture::Png;
+
+static QList<Logo *> createLogos(int count)
+{
+    QList<Logo *> logos;
+    for (int i = 0; i < count; ++i)
+        logos.append(new Logo);
+    return logos;
+}
 
 GLWidget::GLWidget(QWidget *parent)
     : QOpenGLWidget(parent)
+    , m_logos(createLogos(DevicePool::deviceCount()))
+    , m_renderer(m_logos)
+    , m_volumeRenderer(m_logos)
+    , m_serial(++m_widgetCount)
+    , m_statsOverlay(m_defaultStatsOverlay)
+    , m_renderMode(m_defaultRenderMode)
 {
+    for (const Logo *logo : m_logos)
+        m_pacers.append(new FramePacer(logo->ledCount()));
+    setRotationFromAngles();
+
     m_core = QSurfaceFormat::defaultFormat().profile() == QSurfaceFormat::CoreProfile;
     // --transparent causes the clear color to be transparent. Therefore, on systems that
     // support it, the widget will become transparent apart from the logo.
@@ -22,40 +57,59 @@ GLWidget::GLWidget(QWidget *parent)
         setFormat(fmt);
     }
 
-
-    socket =  std::make_shared<QTcpSocket>(this);
-
-    //Connect signal to glWidget and to this window
-    connect( socket.get(), SIGNAL(connected()), this, SLOT(connected()) );
-    //Disconnect signal to glWidget and to this window
-    connect( socket.get(), SIGNAL(disconnected()), this, SLOT(disconnected()) );
-    //readRead signal to glWidget
-    connect( socket.get(), SIGNAL(readyRead()), this, SLOT(readyRead()) );
-    //bytesWritten signal to glWidget
-    connect( socket.get(), SIGNAL(bytesWritten(qint64)), this, SLOT(bytesWritten(qint64)) );
-
-    /* >>>>>>>>>Initialize socket (move it later to connect button)<<<<<<<<<<< */
-    socket->connectToHost("192.168.0.24", 1234);
-    qDebug() << "Connecting...";
-
-    if (socket->state() != QAbstractSocket::ConnectedState
-            && !socket->waitForConnected(1000))
-    {
-        qDebug() << "Error while connecting: " << socket->error() << "\n";
-    }
-    /* >>>>>>>>>Initialize socket (move it later to connect button)<<<<<<<<<<< */
+    // Frames wait in the pacer for their playout time. A due frame is shown
+    // at the next display refresh and the following one is not looked at
+    // before that refresh has been swapped.
+    m_pacingTimer.setSingleShot(true);
+    m_pacingTimer.setTimerType(Qt::PreciseTimer);
+    connect(&m_pacingTimer, &QTimer::timeout, this, &GLWidget::presentFrames);
+    connect(this, &QOpenGLWidget::frameSwapped, this, &GLWidget::frameSwapped);
+
+    // The overlay is refreshed even while no frames arrive.
+    m_overlayTimer.setInterval(500);
+    connect(&m_overlayTimer, &QTimer::timeout, this, QOverload<>::of(&QWidget::update));
+    if (m_statsOverlay)
+        m_overlayTimer.start();
+
+    // Socket I/O and decoding run on the device pool threads, only finished
+    // frames reach the GUI thread.
+    connect(&m_devices, &DevicePool::frameAvailable, this, &GLWidget::frameAvailable);
+    connect(&m_devices, &DevicePool::connectionStateChanged, this, &GLWidget::connectionStateChanged);
+    m_devices.start();
+
+    if (!m_captureDirectory.isEmpty())
+        toggleCapture();
 }
 
 GLWidget::~GLWidget()
 {
-    socket->disconnectFromHost();
-    if (socket->state() != QAbstractSocket::UnconnectedState
-            && !socket->waitForDisconnected())
-    {
-        qDebug() << "Error while disconnecting: " << socket->error() << "\n";
+    m_devices.stop();
+    if (m_capture.isActive()) {
+        makeCurrent();
+        m_capture.stop();
+        doneCurrent();
     }
-    socket->close();
     cleanup();
+    // Unlike after a reparent nothing of this widget is drawn again, its
+    // state goes from the shared cache too.
+    makeCurrent();
+    m_renderer.release();
+    m_volumeRenderer.release();
+    doneCurrent();
+    delete m_threadedRenderer;
+    qDeleteAll(m_pacers);
+    qDeleteAll(m_logos);
+}
+
+bool GLWidget::renderModeFromString(const QString &name, RenderMode *mode)
+{
+    if (name == QLatin1String("mesh"))
+        *mode = MeshRendering;
+    else if (name == QLatin1String("volume"))
+        *mode = VolumeRendering;
+    else
+        return false;
+    return true;
 }
 
 QSize GLWidget::minimumSizeHint() const
@@ -82,7 +136,7 @@ void GLWidget::setXRotation(int angle)
     if (angle != m_xRot) {
         m_xRot = angle;
         emit xRotationChanged(angle);
-        update();
+        setRotationFromAngles();
     }
 }
 
@@ -92,7 +146,7 @@ void GLWidget::setYRotation(int angle)
     if (angle != m_yRot) {
         m_yRot = angle;
         emit yRotationChanged(angle);
-        update();
+        setRotationFromAngles();
     }
 }
 
@@ -102,132 +156,259 @@ void GLWidget::setZRotation(int angle)
     if (angle != m_zRot) {
         m_zRot = angle;
         emit zRotationChanged(angle);
-        update();
+        setRotationFromAngles();
+    }
+}
+
+void GLWidget::setRotationFromAngles()
+{
+    m_rotation = QQuaternion::fromAxisAndAngle(1, 0, 0, 180.0f - m_xRot / 16.0f)
+            * QQuaternion::fromAxisAndAngle(0, 1, 0, m_yRot / 16.0f)
+            * QQuaternion::fromAxisAndAngle(0, 0, 1, m_zRot / 16.0f);
+    m_spinning = false;
+    update();
+}
+
+void GLWidget::applyCameraInput()
+{
+    const qint64 now = FramePacer::now();
+    const GLfloat dt = m_lastPaint ? qMin((now - m_lastPaint) / 1e9f, 0.1f) : 0.0f;
+    m_lastPaint = now;
+
+    if (!m_pendingRotation.isIdentity()) {
+        m_rotation = m_pendingRotation * m_rotation;
+        // The step of this frame is what a release spins on with.
+        if (dt > 0) {
+            GLfloat angle;
+            m_pendingRotation.getAxisAndAngle(&m_spinAxis, &angle);
+            m_spinSpeed = angle / dt;
+        }
+        m_pendingRotation = QQuaternion();
+    } else if (m_spinning) {
+        m_rotation = QQuaternion::fromAxisAndAngle(m_spinAxis, m_spinSpeed * dt) * m_rotation;
+        m_spinSpeed *= expf(-dt / CAMERA_SPIN_DECAY);
+        m_spinning = m_spinSpeed >= CAMERA_SPIN_MIN_SPEED;
+    } else {
+        return;
+    }
+    m_rotation.normalize();
+
+    // Back to slider angles, the rotation is Rx(a) * Ry(b) * Rz(c). At
+    // b = +-90 degrees only a + c is known and c is taken as 0.
+    const QMatrix3x3 m = m_rotation.toRotationMatrix();
+    const GLfloat b = asinf(qBound(-1.0f, m(0, 2), 1.0f));
+    GLfloat a = atan2f(m(2, 1), m(1, 1));
+    GLfloat c = 0;
+    if (qAbs(m(0, 2)) < 0.9999f) {
+        a = atan2f(-m(1, 2), m(2, 2));
+        c = atan2f(-m(0, 1), m(0, 0));
+    }
+    int angles[3] = {
+        qRound((180.0f - qRadiansToDegrees(a)) * 16),
+        qRound(qRadiansToDegrees(b) * 16),
+        qRound(qRadiansToDegrees(c) * 16)
+    };
+    for (int &angle : angles)
+        qNormalizeAngle(angle);
+    if (angles[0] != m_xRot) {
+        m_xRot = angles[0];
+        emit xRotationChanged(m_xRot);
+    }
+    if (angles[1] != m_yRot) {
+        m_yRot = angles[1];
+        emit yRotationChanged(m_yRot);
+    }
+    if (angles[2] != m_zRot) {
+        m_zRot = angles[2];
+        emit zRotationChanged(m_zRot);
     }
 }
 
 void GLWidget::cleanup()
 {
-    if (m_program == nullptr)
+    if (!m_renderer.isInitialized() && !m_blitter)
         return;
     makeCurrent();
-    m_logoVbo.destroy();
-    delete m_program;
-    m_program = nullptr;
+    m_renderer.cleanup();
+    m_volumeRenderer.cleanup();
+#if !QT_CONFIG(opengles2)
+    for (int i = 0; i < GPU_QUERY_COUNT; ++i) {
+        delete m_gpuQueries[i];
+        m_gpuQueries[i] = nullptr;
+        m_gpuQueryPending[i] = false;
+    }
+#endif
+    m_gpuTiming = false;
+    m_capture.cleanup();
+    delete m_blitter;
+    m_blitter = nullptr;
     doneCurrent();
+    // Its context shares with the one going away. The Logos stay, the next
+    // start draws them again.
+    if (m_threadedRenderer)
+        m_threadedRenderer->stop();
     QObject::disconnect(context(), &QOpenGLContext::aboutToBeDestroyed, this, &GLWidget::cleanup);
 }
 
-void GLWidget::connected()
+void GLWidget::frameAvailable(int device)
 {
-    qDebug() << "Connected in graphics widget";
+    FrameReceiver *receiver = m_devices.receiver(device);
+    if (!receiver)
+        return;
+
+    FramePacer *pacer = m_pacers.at(device);
+    while (const LedFrame *frame = receiver->acquireNextFrame()) {
+        pacer->push(*frame);
+        receiver->releaseFrame();
+    }
+    presentFrames();
 }
 
-void GLWidget::disconnected()
+void GLWidget::presentFrames()
 {
-    qDebug() << "Disconnected in graphics widget";
+    // The refresh showing the previous frame has not been swapped yet.
+    if (m_awaitingSwap)
+        return;
+
+    // Every device with a due frame is updated for the same refresh.
+    // Identical consecutive frames are not repainted. The end to end time
+    // is taken from the oldest frame shown.
+    const qint64 now = FramePacer::now();
+    bool changed = false;
+    for (int i = 0; i < m_pacers.size(); ++i) {
+        const LedFrame *frame = m_pacers.at(i)->frameForDisplay(now);
+        if (!frame || !m_logos.at(i)->apply(*frame))
+            continue;
+        if (m_threadedRenderer)
+            m_threadedRenderer->setFrame(i, *frame);
+        if (!changed || frame->received < m_frameReceived)
+            m_frameReceived = frame->received;
+        PipelineStats::instance().record(PipelineStats::ParseToApply, FramePacer::now() - frame->timestamp);
+        changed = true;
+    }
+
+    if (changed) {
+        m_frameApplied = FramePacer::now();
+        m_frameSubmitted = 0;
+        m_awaitingSwap = true;
+        // The render thread asks for the repaint once the frame is drawn.
+        if (!m_threadedRenderer)
+            update();
+        return;
+    }
+    schedulePresentation(now);
+}
+
+void GLWidget::frameSwapped()
+{
+    if (m_frameSubmitted) {
+        const qint64 presented = FramePacer::now();
+        PipelineStats &stats = PipelineStats::instance();
+        stats.record(PipelineStats::SubmitToPresent, presented - m_frameSubmitted);
+        stats.record(PipelineStats::EndToEnd, presented - m_frameReceived);
+        m_frameSubmitted = 0;
+    }
+    m_awaitingSwap = false;
+    presentFrames();
+    // One step of the spin per display refresh.
+    if (m_spinning)
+        update();
 }
 
-void GLWidget::readyRead()
+void GLWidget::toggleStatsOverlay()
 {
-    QString X_idx;
-    QString Y_idx;
-    QString Z_idx;
-    int X, Y, Z;
-    int end_index;
-    QStringList str_list;
+    m_statsOverlay = !m_statsOverlay;
+    if (m_statsOverlay)
+        m_overlayTimer.start();
+    else
+        m_overlayTimer.stop();
+    update();
+}
 
-    // qDebug() << "Reading: " << socket->bytesAvailable();
+void GLWidget::toggleRenderMode()
+{
+    m_renderMode = m_renderMode == MeshRendering ? VolumeRendering : MeshRendering;
+    // Only the renderer drawing takes the changes off the Logos, the other
+    // one starts over from the full state.
+    for (Logo *logo : m_logos)
+        logo->mark_dirty();
+    update();
+}
 
-    socket_buffer += socket->readAll();
-    // qDebug() << socket_buffer;
+void GLWidget::toggleCapture()
+{
+    if (m_capture.isActive()) {
+        makeCurrent();
+        m_capture.stop();
+        doneCurrent();
+        return;
+    }
+    // Windows capture side by side, each into a directory of its own.
+    const QDir directory(m_captureDirectory.isEmpty() ? QStringLiteral("capture") : m_captureDirectory);
+    QString error;
+    if (!m_capture.start(directory.filePath(QStringLiteral("window-%1").arg(m_serial)), m_captureFormat, &error)) {
+        qWarning("%s", qPrintable(error));
+        return;
+    }
+    if (context() && !m_capture.isInitialized())
+        qWarning("Capturing needs OpenGL 3.2 or OpenGL ES 3.0");
+}
 
-    end_index = socket_buffer.indexOf("----\r\n");
-    if(end_index != -1)
-    {
-        m_logo.clear_leds();
-        str_list = socket_buffer.split(":", Qt::SkipEmptyParts);
-        while (!(str_list.size() < 3) && str_list.first() != "----\r\n")
-        {
-            X_idx = str_list.takeFirst();
-            Y_idx = str_list.takeFirst();
-            Z_idx = str_list.takeFirst();
+void GLWidget::dumpStats()
+{
+    QJsonObject frames;
+    frames["presented"] = qint64(pacerTotal(&FramePacer::framesPresented));
+    frames["late"] = qint64(pacerTotal(&FramePacer::framesLate));
+    frames["dropped_pacer"] = qint64(pacerTotal(&FramePacer::framesDropped));
+    frames["dropped_ring"] = qint64(m_devices.framesDropped());
+    frames["coalesced"] = qint64(pacerTotal(&FramePacer::framesCoalesced));
+    frames["duplicated"] = qint64(pacerTotal(&FramePacer::framesDuplicated));
+    QJsonObject devices;
+    devices["count"] = m_devices.size();
+    devices["connected"] = m_devices.connectedCount();
+    devices["threads"] = m_devices.workerCount();
+    if (m_threadedRenderer)
+        frames["rendered_thread"] = qint64(m_threadedRenderer->framesRendered());
+    QJsonObject capture;
+    capture["captured"] = qint64(m_capture.framesCaptured());
+    capture["written"] = qint64(m_capture.framesWritten());
+    capture["dropped_gpu"] = qint64(m_capture.framesDroppedGpu());
+    capture["dropped_writer"] = qint64(m_capture.framesDroppedWriter());
+    capture["errors"] = qint64(m_capture.writeErrors());
+    QJsonObject root;
+    root["stages"] = PipelineStats::instance().toJson();
+    root["frames"] = frames;
+    root["devices"] = devices;
+    root["capture"] = capture;
+
+    QFile file(m_statsFile);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        qWarning() << "Cannot write" << m_statsFile << ":" << file.errorString();
+        return;
+    }
+    file.write(QJsonDocument(root).toJson());
+}
 
-            // qDebug() << X_idx<< ":" << Y_idx<< ":" << Z_idx << ":";
-            X = m_logo.Cube_coords.value(X_idx);
-            Y = m_logo.Cube_coords.value(Y_idx);
-            Z = m_logo.Cube_coords.value(Z_idx);
-            m_logo.led_data[X][Y][Z].active = 1;
-            // qDebug() << X<< " " << Y<< " " << Z;
-        }
-        socket->write("S\r\n");
-        socket_buffer.clear();
-        update();
+void GLWidget::schedulePresentation(qint64 now)
+{
+    qint64 wait = -1;
+    for (const FramePacer *pacer : m_pacers) {
+        const qint64 due = pacer->nextDueIn(now);
+        if (due >= 0 && (wait < 0 || due < wait))
+            wait = due;
     }
+    if (wait < 0)
+        return;
+    m_pacingTimer.start(int(wait / 1000000));
 }
 
-void GLWidget::bytesWritten(const qint64 &bytes)
-{
-//    qDebug() << "Written " << bytes << " bytes";
-}
-
-static const char *vertexShaderSourceCore =
-    "#version 150\n"
-    "in vec4 vertex;\n"
-    "in vec3 normal;\n"
-    "out vec3 vert;\n"
-    "out vec3 vertNormal;\n"
-    "uniform mat4 projMatrix;\n"
-    "uniform mat4 mvMatrix;\n"
-    "uniform mat3 normalMatrix;\n"
-    "void main() {\n"
-    "   vert = vertex.xyz;\n"
-    "   vertNormal = normalMatrix * normal;\n"
-    "   gl_Position = projMatrix * mvMatrix * vertex;\n"
-    "}\n";
-
-static const char *fragmentShaderSourceCore =
-    "#version 150\n"
-    "in highp vec3 vert;\n"
-    "in highp vec3 vertNormal;\n"
-    "out highp vec4 fragColor;\n"
-    "uniform highp vec3 lightPos;\n"
-    "void main() {\n"
-    "   highp vec3 L = normalize(lightPos - vert);\n"
-    "   highp float NL = max(dot(normalize(vertNormal), L), 0.0);\n"
-    "   highp vec3 color = vec3(0.39, 1.0, 0.0);\n"  //COLOR 1
-    "   highp vec3 col = clamp(color * 0.2 + color * 0.8 * NL, 0.0, 1.0);\n"
-    "   fragColor = vec4(col, 1.0);\n"
-    "}\n";
-
-static const char *vertexShaderSource =
-    "attribute vec4 vertex;\n"
-    "attribute vec3 normal;\n"
-    "varying vec3 vert;\n"
-    "varying vec3 vertNormal;\n"
-    "uniform mat4 projMatrix;\n"
-    "uniform mat4 mvMatrix;\n"
-    "uniform mat3 normalMatrix;\n"
-    "void main() {\n"
-    "   vert = vertex.xyz;\n"
-    "   vertNormal = normalMatrix * normal;\n"
-    "   gl_Position = projMatrix * mvMatrix * vertex;\n"
-    "}\n";
-
-static const char *fragmentShaderSource =
-    "//varying highp vec3 vert;\n"
-    "//varying highp vec3 vertNormal;\n"
-    "//uniform highp vec3 lightPos;\n"
-    "uniform highp vec3 u_color;\n"
-    "void main() {\n"
-    "   //highp vec3 L = normalize(lightPos - vert);\n"
-    "   //highp float NL = max(dot(normalize(vertNormal), L), 0.0);\n"
-    "   //highp vec3 color = vec3(0.35, 0.9, 1.0);\n" //Lights on
-    "   //highp vec3 color = vec3(0.0, 0.0, 1.0);\n" //Lights off
-    "   //highp vec3 col = clamp(color * 0.2 + color * 0.8 * NL, 0.0, 1.0);\n"
-    "   //gl_FragColor = vec4(col, 1.0);\n"
-    "   gl_FragColor = vec4(u_color, 1.0);\n"
-    "}\n";
+quint64 GLWidget::pacerTotal(quint64 (FramePacer::*counter)() const) const
+{
+    quint64 total = 0;
+    for (const FramePacer *pacer : m_pacers)
+        total += (pacer->*counter)();
+    return total;
+}
 
 void GLWidget::initializeGL()
 {
@@ -243,54 +424,48 @@ void GLWidget::initializeGL()
     initializeOpenGLFunctions();
     glClearColor(0, 0, 0, m_transparent ? 0 : 1);
 
-    m_program = new QOpenGLShaderProgram;
-    m_program->addShaderFromSourceCode(QOpenGLShader::Vertex, m_core ? vertexShaderSourceCore : vertexShaderSource);
-    m_program->addShaderFromSourceCode(QOpenGLShader::Fragment, m_core ? fragmentShaderSourceCore : fragmentShaderSource);
-    m_program->bindAttributeLocation("vertex", 0);
-    m_program->bindAttributeLocation("normal", 1);
-    m_program->link();
-
-    m_program->bind();
-    m_projMatrixLoc = m_program->uniformLocation("projMatrix");
-    m_mvMatrixLoc = m_program->uniformLocation("mvMatrix");
-    m_normalMatrixLoc = m_program->uniformLocation("normalMatrix");
-    m_lightPosLoc = m_program->uniformLocation("lightPos");
-    // Custom shader variables:
-    m_colorLoc = m_program->uniformLocation("u_color");
-
-    // Create a vertex array object. In OpenGL ES 2.0 and OpenGL 2.x
-    // implementations this is optional and support may not be present
-    // at all. Nonetheless the below code works in all cases and makes
-    // sure there is a VAO when one is needed.
-    m_vao.create();
-    QOpenGLVertexArrayObject::Binder vaoBinder(&m_vao);
-
-    // Setup our vertex buffer object.
-    m_logoVbo.create();
-    m_logoVbo.bind();
-    m_logoVbo.allocate(m_logo.constData(), m_logo.count() * sizeof(GLfloat));
-
-    // Store the vertex attribute bindings for the program.
-    setupVertexAttribs();
+    if (screen() && screen()->refreshRate() > 0) {
+        for (FramePacer *pacer : m_pacers)
+            pacer->setRefreshInterval(qint64(1e9 / screen()->refreshRate()));
+    }
 
-    // Our camera never changes in this example.
-    m_camera.setToIdentity();
-    m_camera.translate(0, 0, -1);
+    if (!m_capture.initialize() && m_capture.isActive())
+        qWarning("Capturing needs OpenGL 3.2 or OpenGL ES 3.0");
 
-    // Light position is fixed.
-    m_program->setUniformValue(m_lightPosLoc, QVector3D(0, 0, 70));
+    if (m_threadedRendering) {
+        if (!m_threadedRenderer) {
+            m_threadedRenderer = new ThreadedRenderer(m_logos.size());
+            connect(m_threadedRenderer, &ThreadedRenderer::frameReady, this, QOverload<>::of(&QWidget::update));
+        }
+        m_blitter = new QOpenGLTextureBlitter;
+        if (!m_blitter->create() || !m_threadedRenderer->start(context(), m_core)) {
+            qWarning("Cannot start the render thread, drawing on the GUI thread");
+            delete m_blitter;
+            m_blitter = nullptr;
+            delete m_threadedRenderer;
+            m_threadedRenderer = nullptr;
+        }
+    }
+    // The render thread draws with renderers of its own.
+    if (!m_threadedRenderer) {
+        m_renderer.initialize(m_core);
+        if (!m_volumeRenderer.initialize() && m_renderMode == VolumeRendering)
+            qWarning("Volume rendering needs OpenGL 3.2 or OpenGL ES 3.0, drawing meshes");
+    }
 
-    m_program->release();
-}
+#if !QT_CONFIG(opengles2)
+    // Timer queries need OpenGL 3.3 or GL_ARB_timer_query, without them
+    // there is no GPU time.
+    m_gpuTiming = true;
+    for (int i = 0; i < GPU_QUERY_COUNT && m_gpuTiming; ++i) {
+        m_gpuQueries[i] = new QOpenGLTimerQuery;
+        m_gpuTiming = m_gpuQueries[i]->create();
+    }
+#endif
 
-void GLWidget::setupVertexAttribs()
-{
-    m_logoVbo.bind();
-    QOpenGLFunctions *f = QOpenGLContext::currentContext()->functions();
-    f->glEnableVertexAttribArray(0);
-    f->glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 6*sizeof(GLfloat),
-                             nullptr);
-    m_logoVbo.release();
+    // Our camera never changes in this example.
+    m_camera.setToIdentity();
+    m_camera.translate(0, 0, -1);
 }
 
 void GLWidget::paintGL()
@@ -299,40 +474,100 @@ void GLWidget::paintGL()
     glEnable(GL_DEPTH_TEST);
     glEnable(GL_CULL_FACE);
 
+    applyCameraInput();
     m_world.setToIdentity();
-    m_world.rotate(180.0f - (m_xRot / 16.0f), 1, 0, 0);
-    m_world.rotate(m_yRot / 16.0f, 0, 1, 0);
-    m_world.rotate(m_zRot / 16.0f, 0, 0, 1);
-
-    QOpenGLVertexArrayObject::Binder vaoBinder(&m_vao);
-    m_program->bind();
-    m_program->setUniformValue(m_projMatrixLoc, m_proj);
-    m_program->setUniformValue(m_mvMatrixLoc, m_camera * m_world);
-    QMatrix3x3 normalMatrix = m_world.normalMatrix();
-    m_program->setUniformValue(m_normalMatrixLoc, normalMatrix);
-
-    QVector3D Vec3D_LightOn(0.35, 0.9, 1.0);
-    QVector3D Vec3D_LightOff(0.0, 0.0, 1.0);
-
-    for (int i = 0; i < MAX_LEDS_X; ++i)
-    {
-        for (int j = 0; j < MAX_LEDS_Y; ++j)
-        {
-            for (int k = 0; k < MAX_LEDS_Z; ++k)
-            {
-                if (m_logo.led_data[i][j][k].active)
-                    m_program->setUniformValue(m_colorLoc, Vec3D_LightOn);
-                else
-                    m_program->setUniformValue(m_colorLoc, Vec3D_LightOff);
-
-                glDrawArrays(GL_TRIANGLES                               // Draw mode
-                             ,m_logo.led_data[i][j][k].startingVertex   // Starting index
-                             ,36                                        // Length
-                            );
-            }
-        }
+    m_world.rotate(m_rotation);
+
+#if !QT_CONFIG(opengles2)
+    collectGpuTimes();
+    QOpenGLTimerQuery *query = m_gpuTiming && !m_gpuQueryPending[m_gpuQuery]
+            ? m_gpuQueries[m_gpuQuery] : nullptr;
+    if (query)
+        query->begin();
+#endif
+    // A repaint of the threaded renderer's old frame does not submit the
+    // applied one.
+    bool submitted = true;
+    if (m_threadedRenderer)
+        submitted = paintThreadedFrame();
+    else if (m_renderMode == VolumeRendering && m_volumeRenderer.isInitialized())
+        m_volumeRenderer.render(m_proj, m_camera * m_world, m_world.normalMatrix());
+    else
+        m_renderer.render(m_proj, m_camera * m_world, m_world.normalMatrix());
+#if !QT_CONFIG(opengles2)
+    if (query) {
+        query->end();
+        m_gpuQueryPending[m_gpuQuery] = true;
+        m_gpuQuery = (m_gpuQuery + 1) % GPU_QUERY_COUNT;
     }
-m_program->release();
+#endif
+
+    if (m_frameApplied && submitted) {
+        m_frameSubmitted = FramePacer::now();
+        PipelineStats::instance().record(PipelineStats::ApplyToSubmit, m_frameSubmitted - m_frameApplied);
+        m_frameApplied = 0;
+    }
+
+    // Before the overlay, only the cube is recorded.
+    m_capture.capture(size() * devicePixelRatio(), format().samples() > 0);
+
+    if (m_statsOverlay)
+        paintStatsOverlay();
+}
+
+bool GLWidget::paintThreadedFrame()
+{
+    // A changed view is drawn by the render thread, until then the last
+    // frame is shown as it is.
+    m_threadedRenderer->setView(size() * devicePixelRatio(), m_proj, m_camera * m_world,
+                                m_world.normalMatrix(), m_renderMode == VolumeRendering);
+    bool fresh = false;
+    const GLuint texture = m_threadedRenderer->acquireTexture(&fresh);
+    if (!texture)
+        return false;
+
+    glDisable(GL_DEPTH_TEST);
+    glDisable(GL_CULL_FACE);
+    glEnable(GL_BLEND);
+    glBlendFunc(GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
+    m_blitter->bind();
+    m_blitter->blit(texture, QMatrix4x4(), QOpenGLTextureBlitter::OriginBottomLeft);
+    m_blitter->release();
+    glDisable(GL_BLEND);
+    return fresh;
+}
+
+void GLWidget::collectGpuTimes()
+{
+#if !QT_CONFIG(opengles2)
+    // Never stall on a result, queries not done yet are looked at next frame.
+    for (int i = 0; i < GPU_QUERY_COUNT; ++i) {
+        if (!m_gpuQueryPending[i] || !m_gpuQueries[i]->isResultAvailable())
+            continue;
+        PipelineStats::instance().record(PipelineStats::GpuDraw, qint64(m_gpuQueries[i]->waitForResult()));
+        m_gpuQueryPending[i] = false;
+    }
+#endif
+}
+
+void GLWidget::paintStatsOverlay()
+{
+    const QStringList lines = PipelineStats::instance().summary();
+
+    QPainter painter(this);
+    QFont font(QStringLiteral("monospace"));
+    font.setStyleHint(QFont::TypeWriter);
+    painter.setFont(font);
+    const QFontMetrics metrics(font);
+    const int lineHeight = metrics.height();
+    int width = 0;
+    for (const QString &line : lines)
+        width = qMax(width, metrics.horizontalAdvance(line));
+
+    painter.fillRect(QRect(4, 4, width + 8, lines.size() * lineHeight + 8), QColor(0, 0, 0, 160));
+    painter.setPen(Qt::white);
+    for (int i = 0; i < lines.size(); ++i)
+        painter.drawText(8, 8 + i * lineHeight + metrics.ascent(), lines.at(i));
 }
 
 void GLWidget::resizeGL(int w, int h)
@@ -341,22 +576,48 @@ void GLWidget::resizeGL(int w, int h)
     m_proj.perspective(45.0f, GLfloat(w) / h, 0.01f, 100.0f);
 }
 
+QVector3D GLWidget::arcballPoint(const QPointF &pos) const
+{
+    // On the sphere filling the widget, or its rim for points outside.
+    const GLfloat radius = qMin(width(), height()) / 2.0f;
+    QVector3D point((pos.x() - width() / 2.0f) / radius, (height() / 2.0f - pos.y()) / radius, 0.0f);
+    const GLfloat length = point.lengthSquared();
+    if (length <= 1.0f)
+        point.setZ(sqrtf(1.0f - length));
+    else
+        point.normalize();
+    return point;
+}
+
 void GLWidget::mousePressEvent(QMouseEvent *event)
 {
-    m_lastPos = event->position().toPoint();
+    m_lastPos = event->position();
+    m_spinning = false;
+    m_spinSpeed = 0;
 }
 
 void GLWidget::mouseMoveEvent(QMouseEvent *event)
 {
-    int dx = event->position().toPoint().x() - m_lastPos.x();
-    int dy = event->position().toPoint().y() - m_lastPos.y();
+    // Only gathered here, the next paintGL() applies all of it at once.
+    const QPointF pos = event->position();
+    QQuaternion step;
+    if (event->buttons() & Qt::LeftButton)
+        step = QQuaternion::rotationTo(arcballPoint(m_lastPos), arcballPoint(pos));
+    else if (event->buttons() & Qt::RightButton)
+        step = QQuaternion::fromAxisAndAngle(0, 0, 1, GLfloat(pos.x() - m_lastPos.x()) / 2);
+    m_lastPos = pos;
+    if (step.isIdentity())
+        return;
+    m_pendingRotation = step * m_pendingRotation;
+    m_lastDrag = FramePacer::now();
+    m_spinning = false;
+    update();
+}
 
-    if (event->buttons() & Qt::RightButton) {
-        setXRotation(m_xRot + 8 * dy);
-        setYRotation(m_yRot + 8 * dx);
-    } else if (event->buttons() & Qt::LeftButton) {
-        setXRotation(m_xRot + 8 * dy);
-        setZRotation(m_zRot + 8 * dx);
-    }
-    m_lastPos = event->position().toPoint();
+void GLWidget::mouseReleaseEvent(QMouseEvent *)
+{
+    m_spinning = m_inertia && m_spinSpeed >= CAMERA_SPIN_MIN_SPEED
+            && FramePacer::now() - m_lastDrag < CAMERA_RELEASE_WINDOW * qint64(1000000);
+    if (m_spinning)
+        update();
 }
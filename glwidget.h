@@ -6,48 +6,96 @@
 
 #include <QOpenGLWidget>
 #include <QOpenGLFunctions>
-#include <QOpenGLVertexArrayObject>
-#include <QOpenGLBuffer>
 #include <QMatrix4x4>
+#include <QQuaternion>
+#include <QTimer>
 #include "logo.h"
-
-#include <QTcpSocket>
-#include <memory>
-
-
-
-QT_FORWARD_DECLARE_CLASS(QOpenGLShaderProgram)
+#include "latticerenderer.h"
+#include "volumerenderer.h"
+#include "devicepool.h"
+#include "framepacer.h"
+#include "pipelinestats.h"
+#include "threadedrenderer.h"
+#include "framecapture.h"
+
+// Timer queries in flight, results are collected a few frames later.
+#define GPU_QUERY_COUNT 4
+// Seconds for a released spin to slow down to 1/e of its speed.
+#define CAMERA_SPIN_DECAY 0.6f
+// Degrees per second below which a spin stops.
+#define CAMERA_SPIN_MIN_SPEED 2.0f
+// A drag resting longer than this before the release does not spin, ms.
+#define CAMERA_RELEASE_WINDOW 50
+
+#if !QT_CONFIG(opengles2)
+QT_FORWARD_DECLARE_CLASS(QOpenGLTimerQuery)
+#endif
+QT_FORWARD_DECLARE_CLASS(QOpenGLTextureBlitter)
 
 class GLWidget : public QOpenGLWidget, protected QOpenGLFunctions
 {
     Q_OBJECT
 
 public:
+    // Mesh draws one cube per LED, Volume ray marches a texture of the
+    // LED states. Volume falls back to Mesh on contexts without it.
+    enum RenderMode {
+        MeshRendering,
+        VolumeRendering
+    };
+
     GLWidget(QWidget *parent = nullptr);
     ~GLWidget();
 
     static bool isTransparent() { return m_transparent; }
     static void setTransparent(bool t) { m_transparent = t; }
+    // Whether new widgets show the overlay, each toggles its own.
+    static bool defaultStatsOverlay() { return m_defaultStatsOverlay; }
+    static void setDefaultStatsOverlay(bool s) { m_defaultStatsOverlay = s; }
+    static QString statsFile() { return m_statsFile; }
+    static void setStatsFile(const QString &fileName) { m_statsFile = fileName; }
+    // Mode new widgets start in, each toggles its own.
+    static RenderMode defaultRenderMode() { return m_defaultRenderMode; }
+    static void setDefaultRenderMode(RenderMode mode) { m_defaultRenderMode = mode; }
+    static bool renderModeFromString(const QString &name, RenderMode *mode);
+    // Draw on a ThreadedRenderer, paintGL() only composites its frames.
+    static bool isThreadedRendering() { return m_threadedRendering; }
+    static void setThreadedRendering(bool threaded) { m_threadedRendering = threaded; }
+    // Captured frames go to a window-n subdirectory of captureDirectory(),
+    // ./capture when empty, one per widget in the order they were made.
+    // Capturing starts right away when it is set before the widget is made.
+    static QString captureDirectory() { return m_captureDirectory; }
+    static void setCaptureDirectory(const QString &directory) { m_captureDirectory = directory; }
+    static FrameCapture::Format captureFormat() { return m_captureFormat; }
+    static void setCaptureFormat(FrameCapture::Format format) { m_captureFormat = format; }
+    // Keep spinning after a drag is released, slowing down.
+    static bool hasInertia() { return m_inertia; }
+    static void setInertia(bool inertia) { m_inertia = inertia; }
 
     QSize minimumSizeHint() const override;
     QSize sizeHint() const override;
 
+    const DevicePool &devices() const { return m_devices; }
+    const FramePacer &pacer(int device) const { return *m_pacers.at(device); }
+    bool isStatsOverlay() const { return m_statsOverlay; }
+    RenderMode renderMode() const { return m_renderMode; }
+
 public slots:
     void setXRotation(int angle);
     void setYRotation(int angle);
     void setZRotation(int angle);
     void cleanup();
-
-    //Socket slots
-    void connected();
-    void disconnected();
-    void readyRead();
-    void bytesWritten(const qint64 &bytes);
+    void frameAvailable(int device);
+    void toggleStatsOverlay();
+    void toggleRenderMode();
+    void toggleCapture();
+    void dumpStats();
 
 signals:
     void xRotationChanged(int angle);
     void yRotationChanged(int angle);
     void zRotationChanged(int angle);
+    void connectionStateChanged(int device, FrameReceiver::ConnectionState state);
 
 protected:
     void initializeGL() override;
@@ -55,32 +103,75 @@ protected:
     void resizeGL(int width, int height) override;
     void mousePressEvent(QMouseEvent *event) override;
     void mouseMoveEvent(QMouseEvent *event) override;
+    void mouseReleaseEvent(QMouseEvent *event) override;
 
 private:
-    void setupVertexAttribs();
+    QVector3D arcballPoint(const QPointF &pos) const;
+    void applyCameraInput();
+    void setRotationFromAngles();
+    void presentFrames();
+    void schedulePresentation(qint64 now);
+    quint64 pacerTotal(quint64 (FramePacer::*counter)() const) const;
+    void frameSwapped();
+    void collectGpuTimes();
+    void paintStatsOverlay();
+    // Whether the frame shown is a new one.
+    bool paintThreadedFrame();
 
-    QString socket_buffer;
     bool m_core;
+    // The camera is m_rotation. The slider angles, rotations around x, y
+    // and z applied in that order, follow it after camera input; set from
+    // the sliders they are kept as they are.
+    QQuaternion m_rotation;
     int m_xRot = 0;
     int m_yRot = 0;
     int m_zRot = 0;
-    QPoint m_lastPos;
-    Logo m_logo;
-    QOpenGLVertexArrayObject m_vao;
-    QOpenGLBuffer m_logoVbo;
-    QOpenGLShaderProgram *m_program = nullptr;
-    int m_projMatrixLoc = 0;
-    int m_mvMatrixLoc = 0;
-    int m_normalMatrixLoc = 0;
-    int m_lightPosLoc = 0;
-    int m_colorLoc = 0;
+    QPointF m_lastPos;
+    // Mouse input since the last paint, applied once per frame.
+    QQuaternion m_pendingRotation;
+    qint64 m_lastPaint = 0;
+    qint64 m_lastDrag = 0;
+    QVector3D m_spinAxis;
+    GLfloat m_spinSpeed = 0;
+    bool m_spinning = false;
+    // One Logo and pacer per device, all drawn by the one renderer.
+    QList<Logo *> m_logos;
+    QList<FramePacer *> m_pacers;
+    LatticeRenderer m_renderer;
+    VolumeRenderer m_volumeRenderer;
+    ThreadedRenderer *m_threadedRenderer = nullptr;
+    QOpenGLTextureBlitter *m_blitter = nullptr;
+    FrameCapture m_capture;
+    int m_serial;
+    QTimer m_pacingTimer;
+    bool m_awaitingSwap = false;
+    // Stage timestamps of the frame on its way to the screen.
+    qint64 m_frameReceived = 0;
+    qint64 m_frameApplied = 0;
+    qint64 m_frameSubmitted = 0;
+#if !QT_CONFIG(opengles2)
+    QOpenGLTimerQuery *m_gpuQueries[GPU_QUERY_COUNT] = {};
+    bool m_gpuQueryPending[GPU_QUERY_COUNT] = {};
+    int m_gpuQuery = 0;
+#endif
+    bool m_gpuTiming = false;
+    bool m_statsOverlay;
+    RenderMode m_renderMode;
+    QTimer m_overlayTimer;
     QMatrix4x4 m_proj;
     QMatrix4x4 m_camera;
     QMatrix4x4 m_world;
     static bool m_transparent;
-
-    //Socket ptr
-    std::shared_ptr<QTcpSocket> socket = nullptr;
+    static bool m_defaultStatsOverlay;
+    static QString m_statsFile;
+    static RenderMode m_defaultRenderMode;
+    static bool m_threadedRendering;
+    static bool m_inertia;
+    static QString m_captureDirectory;
+    static int m_widgetCount;
+    static FrameCapture::Format m_captureFormat;
+
+    DevicePool m_devices;
 };
 
 #endif
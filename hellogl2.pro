@@ -1,14 +1,45 @@
 HEADERS       = glwidget.h \
                 window.h \
                 mainwindow.h \
-                logo.h
+                logo.h \
+                glresourcecache.h \
+                latticelod.h \
+                latticerenderer.h \
+                frameparser.h \
+                cubeconfig.h \
+                devicepool.h \
+                framereceiver.h \
+                framecapture.h \
+                framepacer.h \
+                patternengine.h \
+                sessionfile.h \
+                pipelinestats.h \
+                spscring.h \
+                threadedrenderer.h \
+                volumerenderer.h \
+                voxelgrid.h
 SOURCES       = glwidget.cpp \
                 main.cpp \
                 window.cpp \
                 mainwindow.cpp \
-                logo.cpp
+                logo.cpp \
+                glresourcecache.cpp \
+                latticelod.cpp \
+                latticerenderer.cpp \
+                frameparser.cpp \
+                cubeconfig.cpp \
+                devicepool.cpp \
+                framereceiver.cpp \
+                framecapture.cpp \
+                framepacer.cpp \
+                patternengine.cpp \
+                pipelinestats.cpp \
+                sessionfile.cpp \
+                threadedrenderer.cpp \
+                volumerenderer.cpp \
+                voxelgrid.cpp
 
-QT += widgets opengl openglwidgets
+QT += widgets opengl openglwidgets network
 
 # install
 target.path = $$[QT_INSTALL_EXAMPLES]/opengl/hellogl2
@@ -0,0 +1,219 @@
+// Copyright (C) 2016 The Qt Company Ltd.
+// SPDX-License-Identifier: LicenseRef-Qt-Commercial OR BSD-3-Clause
+
+#include "latticelod.h"
+#include "latticerenderer.h"
+#include "frameparser.h"
+#include <QVector4D>
+#include <cstring>
+
+// Same off look as the renderers, merged blocks average what they show.
+static const QVector3D Vec3D_LightOff(0.0f, 0.0f, 1.0f);
+
+GLfloat LatticeLod::m_threshold = LOD_DEFAULT_PIXELS;
+
+LatticeLod::LatticeLod(const QList<Logo *> &logos)
+    : m_logos(logos)
+    , m_config(logos.first()->config())
+{
+    m_bricksX = (m_config.sizeX + LOD_BRICK_EDGE - 1) / LOD_BRICK_EDGE;
+    m_bricksY = (m_config.sizeY + LOD_BRICK_EDGE - 1) / LOD_BRICK_EDGE;
+    m_bricksZ = (m_config.sizeZ + LOD_BRICK_EDGE - 1) / LOD_BRICK_EDGE;
+    m_bricksPerLattice = m_bricksX * m_bricksY * m_bricksZ;
+    m_levels.fill(Full, logos.size() * m_bricksPerLattice);
+    m_brickColors.fill(0, logos.size() * m_bricksPerLattice);
+    m_colorSums.resize(m_bricksPerLattice * 3);
+}
+
+void LatticeLod::updateColors(int lattice, int first, int last)
+{
+    // Whole brick slabs along x, as the dirty range covers whole layers.
+    const int layerSize = m_config.sizeY * m_config.sizeZ;
+    const int bx0 = first / layerSize / LOD_BRICK_EDGE;
+    const int bx1 = last / layerSize / LOD_BRICK_EDGE;
+    const int x1 = qMin(m_config.sizeX, (bx1 + 1) * LOD_BRICK_EDGE);
+    m_colorSums.fill(0.0f);
+    GLfloat *sums = m_colorSums.data();
+    const quint32 *colors = m_logos.at(lattice)->colors();
+    for (int x = bx0 * LOD_BRICK_EDGE; x < x1; ++x) {
+        for (int y = 0; y < m_config.sizeY; ++y) {
+            const quint32 *row = colors + (x * m_config.sizeY + y) * m_config.sizeZ;
+            for (int z = 0; z < m_config.sizeZ; ++z) {
+                uchar rgba[4];
+                memcpy(rgba, row + z, sizeof(rgba));
+                const GLfloat intensity = rgba[3] / 255.0f;
+                GLfloat *sum = sums + brickIndex(x / LOD_BRICK_EDGE, y / LOD_BRICK_EDGE, z / LOD_BRICK_EDGE) * 3;
+                for (int c = 0; c < 3; ++c)
+                    sum[c] += Vec3D_LightOff[c] * (1.0f - intensity) + rgba[c] / 255.0f * intensity;
+            }
+        }
+    }
+
+    quint32 *brickColors = m_brickColors.data() + lattice * m_bricksPerLattice;
+    for (int bx = bx0; bx <= bx1; ++bx) {
+        const int ex = qMin(LOD_BRICK_EDGE, m_config.sizeX - bx * LOD_BRICK_EDGE);
+        for (int by = 0; by < m_bricksY; ++by) {
+            const int ey = qMin(LOD_BRICK_EDGE, m_config.sizeY - by * LOD_BRICK_EDGE);
+            for (int bz = 0; bz < m_bricksZ; ++bz) {
+                const int ez = qMin(LOD_BRICK_EDGE, m_config.sizeZ - bz * LOD_BRICK_EDGE);
+                const int brick = brickIndex(bx, by, bz);
+                const GLfloat scale = 255.0f / (ex * ey * ez);
+                brickColors[brick] = ledColor(uchar(sums[brick * 3] * scale + 0.5f),
+                                              uchar(sums[brick * 3 + 1] * scale + 0.5f),
+                                              uchar(sums[brick * 3 + 2] * scale + 0.5f), 255);
+            }
+        }
+    }
+}
+
+void LatticeLod::brickExtent(int lattice, int bx, int by, int bz, QVector3D *min, QVector3D *max) const
+{
+    // The whole cells of the brick, so neighbouring blocks close up. At the
+    // far side of the lattice it ends with the last LED.
+    const Logo *logo = m_logos.first();
+    const int brick[3] = { bx, by, bz };
+    const int size[3] = { m_config.sizeX, m_config.sizeY, m_config.sizeZ };
+    const QVector3D base = LatticeRenderer::latticeOffset(lattice, m_logos.size()) + logo->origin();
+    for (int i = 0; i < 3; ++i) {
+        const int first = brick[i] * LOD_BRICK_EDGE;
+        const int end = qMin(size[i], first + LOD_BRICK_EDGE);
+        (*min)[i] = base[i] + first * logo->pitch();
+        (*max)[i] = base[i] + (end - 1) * logo->pitch() + (end == size[i] ? logo->ledSize() : logo->pitch());
+    }
+}
+
+bool LatticeLod::isEnclosed(const Level *levels, int bx, int by, int bz) const
+{
+    if (bx == 0 || by == 0 || bz == 0
+            || bx == m_bricksX - 1 || by == m_bricksY - 1 || bz == m_bricksZ - 1)
+        return false;
+    // A culled neighbour lies outside the frustum, so does every ray that
+    // would reach the brick through it.
+    const int neighbours[6] = {
+        brickIndex(bx - 1, by, bz), brickIndex(bx + 1, by, bz),
+        brickIndex(bx, by - 1, bz), brickIndex(bx, by + 1, bz),
+        brickIndex(bx, by, bz - 1), brickIndex(bx, by, bz + 1)
+    };
+    for (int neighbour : neighbours) {
+        if (levels[neighbour] == Full)
+            return false;
+    }
+    return true;
+}
+
+void LatticeLod::addRun(int first, int count)
+{
+    // Only culled instances may be drawn in a gap. Those of merged bricks
+    // would show through, and z-fight with, the blocks.
+    if (m_runBridgeable && !m_runs.isEmpty()) {
+        Run &last = m_runs.last();
+        if (first <= last.first + last.count + LOD_RUN_GAP) {
+            last.count = first + count - last.first;
+            return;
+        }
+    }
+    m_runs.append({ first, count });
+    m_runBridgeable = true;
+}
+
+void LatticeLod::update(const QMatrix4x4 &proj, const QMatrix4x4 &gridModelView, const QSize &viewport)
+{
+    m_runs.clear();
+    m_blocks.clear();
+    m_runBridgeable = false;
+    for (int &count : m_levelCounts)
+        count = 0;
+
+    // Frustum planes in grid space, inside where the dot product is >= 0.
+    const QMatrix4x4 mvp = proj * gridModelView;
+    const QVector4D planes[6] = {
+        mvp.row(3) + mvp.row(0), mvp.row(3) - mvp.row(0),
+        mvp.row(3) + mvp.row(1), mvp.row(3) - mvp.row(1),
+        mvp.row(3) + mvp.row(2), mvp.row(3) - mvp.row(2)
+    };
+    // LED size in pixels at unit eye distance.
+    const Logo *logo = m_logos.first();
+    const GLfloat scale = gridModelView.column(0).toVector3D().length();
+    const GLfloat ledPixels = logo->ledSize() * scale * proj(1, 1) * viewport.height() * 0.5f;
+
+    const int ledCount = logo->ledCount();
+    for (int lattice = 0; lattice < m_logos.size(); ++lattice) {
+        Level *levels = m_levels.data() + lattice * m_bricksPerLattice;
+        for (int bx = 0; bx < m_bricksX; ++bx) {
+            for (int by = 0; by < m_bricksY; ++by) {
+                for (int bz = 0; bz < m_bricksZ; ++bz) {
+                    QVector3D min, max;
+                    brickExtent(lattice, bx, by, bz, &min, &max);
+                    Level level = Full;
+                    for (const QVector4D &plane : planes) {
+                        const QVector3D corner(plane.x() >= 0 ? max.x() : min.x(),
+                                               plane.y() >= 0 ? max.y() : min.y(),
+                                               plane.z() >= 0 ? max.z() : min.z());
+                        if (QVector3D::dotProduct(plane.toVector3D(), corner) + plane.w() < 0) {
+                            level = Culled;
+                            break;
+                        }
+                    }
+                    if (level == Full && m_threshold > 0) {
+                        // Judged by the nearest point the brick could have.
+                        const GLfloat depth = -gridModelView.map((min + max) / 2).z();
+                        const GLfloat nearest = depth - (max - min).length() / 2 * scale;
+                        if (nearest > 0 && ledPixels / nearest < m_threshold)
+                            level = Merged;
+                    }
+                    levels[brickIndex(bx, by, bz)] = level;
+                }
+            }
+        }
+
+        const quint32 *brickColors = m_brickColors.constData() + lattice * m_bricksPerLattice;
+        int fullCount = 0;
+        const int culledBefore = m_levelCounts[Culled];
+        for (int bx = 0; bx < m_bricksX; ++bx) {
+            for (int by = 0; by < m_bricksY; ++by) {
+                for (int bz = 0; bz < m_bricksZ; ++bz) {
+                    const int brick = brickIndex(bx, by, bz);
+                    if (levels[brick] == Merged && isEnclosed(levels, bx, by, bz))
+                        levels[brick] = Hidden;
+                    ++m_levelCounts[levels[brick]];
+                    if (levels[brick] == Full)
+                        ++fullCount;
+                    if (levels[brick] != Merged)
+                        continue;
+                    QVector3D min, max;
+                    brickExtent(lattice, bx, by, bz, &min, &max);
+                    m_blocks.append({ { min.x(), min.y(), min.z() },
+                                      { max.x() - min.x(), max.y() - min.y(), max.z() - min.z() },
+                                      brickColors[brick] });
+                }
+            }
+        }
+
+        // Full bricks as instance runs, a z row of a brick is contiguous.
+        const int base = lattice * ledCount;
+        if (fullCount == m_bricksPerLattice) {
+            addRun(base, ledCount);
+            continue;
+        }
+        if (fullCount == 0) {
+            if (m_levelCounts[Culled] - culledBefore < m_bricksPerLattice)
+                breakRun();
+            continue;
+        }
+        for (int x = 0; x < m_config.sizeX; ++x) {
+            for (int y = 0; y < m_config.sizeY; ++y) {
+                const int row = base + (x * m_config.sizeY + y) * m_config.sizeZ;
+                for (int bz = 0; bz < m_bricksZ; ++bz) {
+                    const Level level = levels[brickIndex(x / LOD_BRICK_EDGE, y / LOD_BRICK_EDGE, bz)];
+                    if (level != Full) {
+                        if (level != Culled)
+                            breakRun();
+                        continue;
+                    }
+                    addRun(row + bz * LOD_BRICK_EDGE,
+                           qMin(LOD_BRICK_EDGE, m_config.sizeZ - bz * LOD_BRICK_EDGE));
+                }
+            }
+        }
+    }
+}
@@ -0,0 +1,93 @@
+// Copyright (C) 2016 The Qt Company Ltd.
+// SPDX-License-Identifier: LicenseRef-Qt-Commercial OR BSD-3-Clause
+
+#ifndef LATTICELOD_H
+#define LATTICELOD_H
+
+#include <QList>
+#include <QSize>
+#include <QMatrix4x4>
+#include "logo.h"
+
+// LEDs per brick edge, the unit of culling and merging.
+#define LOD_BRICK_EDGE 4
+// Culled instances between two runs that are drawn anyway to save a call.
+#define LOD_RUN_GAP 64
+#define LOD_DEFAULT_PIXELS 1.0f
+
+/*
+ * Decides per frame what of a grid of lattices is worth drawing, in bricks
+ * of LOD_BRICK_EDGE^3 LEDs:
+ *   Culled   outside the view frustum
+ *   Full     every LED its own cube
+ *   Merged   LEDs smaller than threshold() pixels, the brick is one block
+ *            in the average color of its LEDs
+ *   Hidden   a merged brick enclosed by merged or culled neighbours, the
+ *            blocks are opaque so nothing of it can show
+ * Full bricks come out as runs of instance indices in LatticeRenderer
+ * order, lattice after lattice; merged bricks as blocks in grid space.
+ */
+class LatticeLod
+{
+public:
+    enum Level : quint8 {
+        Culled,
+        Full,
+        Merged,
+        Hidden
+    };
+
+    struct Run
+    {
+        int first;
+        int count;
+    };
+
+    struct Block
+    {
+        GLfloat min[3];
+        GLfloat size[3];
+        quint32 color;
+    };
+
+    explicit LatticeLod(const QList<Logo *> &logos);
+
+    // 0 never merges.
+    static GLfloat threshold() { return m_threshold; }
+    static void setThreshold(GLfloat pixels) { m_threshold = qMax(0.0f, pixels); }
+
+    // Block colors of the bricks holding LEDs first to last, call before
+    // the Logo's dirty range is cleared.
+    void updateColors(int lattice, int first, int last);
+    void update(const QMatrix4x4 &proj, const QMatrix4x4 &gridModelView, const QSize &viewport);
+
+    const QList<Run> &runs() const { return m_runs; }
+    const QList<Block> &blocks() const { return m_blocks; }
+    int brickCount(Level level) const { return m_levelCounts[level]; }
+
+private:
+    int brickIndex(int bx, int by, int bz) const { return (bx * m_bricksY + by) * m_bricksZ + bz; }
+    void brickExtent(int lattice, int bx, int by, int bz, QVector3D *min, QVector3D *max) const;
+    bool isEnclosed(const Level *levels, int bx, int by, int bz) const;
+    void addRun(int first, int count);
+    // Since the last run a merged or hidden brick's LEDs went by, the next
+    // run must not bridge them.
+    void breakRun() { m_runBridgeable = false; }
+
+    QList<Logo *> m_logos;
+    CubeConfig m_config;
+    int m_bricksX;
+    int m_bricksY;
+    int m_bricksZ;
+    int m_bricksPerLattice;
+    QList<Level> m_levels;
+    QList<quint32> m_brickColors;
+    QList<GLfloat> m_colorSums;
+    QList<Run> m_runs;
+    QList<Block> m_blocks;
+    bool m_runBridgeable = false;
+    int m_levelCounts[4] = {};
+    static GLfloat m_threshold;
+};
+
+#endif // LATTICELOD_H
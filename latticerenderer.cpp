@@ -0,0 +1,579 @@
+// Copyright (C) 2016 The Qt Company Ltd.
+// SPDX-License-Identifier: LicenseRef-Qt-Commercial OR BSD-3-Clause
+
+#include "latticerenderer.h"
+#include <QOpenGLShaderProgram>
+#include <QOpenGLExtraFunctions>
+#include <QOpenGLContext>
+#include <cstddef>
+#include <cmath>
+#include <cstring>
+
+// What an LED at zero intensity looks like, whatever its color.
+static const QVector3D Vec3D_LightOff(0.0f, 0.0f, 1.0f);
+
+// Attribute locations shared by all programs.
+enum {
+    VertexAttrib = 0,
+    NormalAttrib = 1,
+    InstanceColorAttrib = 2,
+    BlockMinAttrib = 3,
+    BlockSizeAttrib = 4,
+    BlockColorAttrib = 5
+};
+
+static const char *vertexShaderSourceCore =
+    "#version 150\n"
+    "in vec4 vertex;\n"
+    "in vec3 normal;\n"
+    "out vec3 vert;\n"
+    "out vec3 vertNormal;\n"
+    "uniform mat4 projMatrix;\n"
+    "uniform mat4 mvMatrix;\n"
+    "uniform mat3 normalMatrix;\n"
+    "uniform vec3 u_offset;\n"
+    "uniform vec3 u_scale;\n"
+    "void main() {\n"
+    "   vec4 eye = mvMatrix * vec4(u_offset + vertex.xyz * u_scale, 1.0);\n"
+    "   vert = eye.xyz;\n"
+    "   vertNormal = normalMatrix * normal;\n"
+    "   gl_Position = projMatrix * eye;\n"
+    "}\n";
+
+static const char *fragmentShaderSourceCore =
+    "#version 150\n"
+    "in highp vec3 vert;\n"
+    "in highp vec3 vertNormal;\n"
+    "out highp vec4 fragColor;\n"
+    "uniform highp vec3 lightPos;\n"
+    "uniform highp vec3 u_color;\n"
+    "void main() {\n"
+    "   highp vec3 L = normalize(lightPos - vert);\n"
+    "   highp float NL = max(dot(normalize(vertNormal), L), 0.0);\n"
+    "   fragColor = vec4(clamp(u_color * 0.2 + u_color * 0.8 * NL, 0.0, 1.0), 1.0);\n"
+    "}\n";
+
+static const char *vertexShaderSource =
+    "attribute vec4 vertex;\n"
+    "attribute vec3 normal;\n"
+    "varying vec3 vert;\n"
+    "varying vec3 vertNormal;\n"
+    "uniform mat4 projMatrix;\n"
+    "uniform mat4 mvMatrix;\n"
+    "uniform mat3 normalMatrix;\n"
+    "uniform vec3 u_offset;\n"
+    "uniform vec3 u_scale;\n"
+    "void main() {\n"
+    "   vec4 eye = mvMatrix * vec4(u_offset + vertex.xyz * u_scale, 1.0);\n"
+    "   vert = eye.xyz;\n"
+    "   vertNormal = normalMatrix * normal;\n"
+    "   gl_Position = projMatrix * eye;\n"
+    "}\n";
+
+static const char *fragmentShaderSource =
+    "varying highp vec3 vert;\n"
+    "varying highp vec3 vertNormal;\n"
+    "uniform highp vec3 lightPos;\n"
+    "uniform highp vec3 u_color;\n"
+    "void main() {\n"
+    "   highp vec3 L = normalize(lightPos - vert);\n"
+    "   highp float NL = max(dot(normalize(vertNormal), L), 0.0);\n"
+    "   gl_FragColor = vec4(clamp(u_color * 0.2 + u_color * 0.8 * NL, 0.0, 1.0), 1.0);\n"
+    "}\n";
+
+// Instancing implies OpenGL 3.3 or OpenGL ES 3.0, so GLSL 3.30 or 3.00 es is
+// always there, core profile or not. The version line is prepended at
+// runtime. Lattice and LED positions come from gl_InstanceID, counted from
+// the start of the run being drawn.
+static const char *vertexShaderSourceInstanced =
+    "in vec4 vertex;\n"
+    "in vec3 normal;\n"
+    "in vec4 instanceColor;\n"
+    "out vec3 vert;\n"
+    "out vec3 vertNormal;\n"
+    "out vec3 color;\n"
+    "uniform mat4 projMatrix;\n"
+    "uniform mat4 mvMatrix;\n"
+    "uniform mat3 normalMatrix;\n"
+    "uniform vec3 u_colorOff;\n"
+    "uniform ivec3 u_latticeSize;\n"
+    "uniform vec3 u_origin;\n"
+    "uniform float u_pitch;\n"
+    "uniform float u_ledSize;\n"
+    "uniform int u_gridColumns;\n"
+    "uniform vec3 u_gridOrigin;\n"
+    "uniform float u_gridSpacing;\n"
+    "uniform int u_instanceBase;\n"
+    "void main() {\n"
+    "   int ledCount = u_latticeSize.x * u_latticeSize.y * u_latticeSize.z;\n"
+    "   int instance = u_instanceBase + gl_InstanceID;\n"
+    "   int lattice = instance / ledCount;\n"
+    "   int led = instance % ledCount;\n"
+    "   ivec3 cell = ivec3(led / (u_latticeSize.y * u_latticeSize.z),\n"
+    "                      (led / u_latticeSize.z) % u_latticeSize.y,\n"
+    "                      led % u_latticeSize.z);\n"
+    "   vec3 grid = u_gridOrigin + vec3(float(lattice % u_gridColumns),\n"
+    "                                   float(lattice / u_gridColumns), 0.0) * u_gridSpacing;\n"
+    "   vec3 position = grid + u_origin + vec3(cell) * u_pitch + vertex.xyz * u_ledSize;\n"
+    "   vec4 eye = mvMatrix * vec4(position, 1.0);\n"
+    "   vert = eye.xyz;\n"
+    "   vertNormal = normalMatrix * normal;\n"
+    "   color = mix(u_colorOff, instanceColor.rgb, instanceColor.a);\n"
+    "   gl_Position = projMatrix * eye;\n"
+    "}\n";
+
+static const char *fragmentShaderSourceInstanced =
+    "in highp vec3 vert;\n"
+    "in highp vec3 vertNormal;\n"
+    "in highp vec3 color;\n"
+    "out highp vec4 fragColor;\n"
+    "uniform highp vec3 lightPos;\n"
+    "void main() {\n"
+    "   highp vec3 L = normalize(lightPos - vert);\n"
+    "   highp float NL = max(dot(normalize(vertNormal), L), 0.0);\n"
+    "   fragColor = vec4(clamp(color * 0.2 + color * 0.8 * NL, 0.0, 1.0), 1.0);\n"
+    "}\n";
+
+// Merged bricks, one box per instance in grid space. Shares the fragment
+// shader with the LEDs.
+static const char *vertexShaderSourceBlock =
+    "in vec4 vertex;\n"
+    "in vec3 normal;\n"
+    "in vec3 blockMin;\n"
+    "in vec3 blockSize;\n"
+    "in vec4 blockColor;\n"
+    "out vec3 vert;\n"
+    "out vec3 vertNormal;\n"
+    "out vec3 color;\n"
+    "uniform mat4 projMatrix;\n"
+    "uniform mat4 mvMatrix;\n"
+    "uniform mat3 normalMatrix;\n"
+    "void main() {\n"
+    "   vec4 eye = mvMatrix * vec4(blockMin + vertex.xyz * blockSize, 1.0);\n"
+    "   vert = eye.xyz;\n"
+    "   vertNormal = normalMatrix * normal;\n"
+    "   color = blockColor.rgb;\n"
+    "   gl_Position = projMatrix * eye;\n"
+    "}\n";
+
+LatticeRenderer::LatticeRenderer(Logo *logo)
+    : LatticeRenderer(QList<Logo *>{ logo })
+{
+}
+
+LatticeRenderer::LatticeRenderer(const QList<Logo *> &logos)
+    : m_logos(logos)
+    , m_lod(logos)
+{
+    for (const Logo *logo : logos) {
+        Q_ASSERT(logo->ledCount() == logos.first()->ledCount());
+        m_instanceCount += logo->instanceCount();
+    }
+}
+
+static int gridColumns(int latticeCount)
+{
+    return qMax(1, int(std::ceil(std::sqrt(double(latticeCount)))));
+}
+
+QVector3D LatticeRenderer::latticeOffset(int lattice, int latticeCount)
+{
+    const int columns = gridColumns(latticeCount);
+    const int rows = (latticeCount + columns - 1) / columns;
+    return QVector3D((lattice % columns - (columns - 1) / 2.0f) * LATTICE_GRID_SPACING,
+                     (lattice / columns - (rows - 1) / 2.0f) * LATTICE_GRID_SPACING,
+                     0.0f);
+}
+
+GLfloat LatticeRenderer::gridScale(int latticeCount)
+{
+    return 1.0f / gridColumns(latticeCount);
+}
+
+QOpenGLShaderProgram *LatticeRenderer::buildProgram(const QByteArray &name, const QByteArray &vertexSource,
+                                                    const QByteArray &fragmentSource)
+{
+    // Linked binaries land in Qt's disk cache, later runs skip compiling.
+    QOpenGLShaderProgram *program = m_cache->program(name);
+    if (program)
+        return program;
+    program = new QOpenGLShaderProgram;
+    program->addCacheableShaderFromSourceCode(QOpenGLShader::Vertex, vertexSource);
+    program->addCacheableShaderFromSourceCode(QOpenGLShader::Fragment, fragmentSource);
+    program->bindAttributeLocation("vertex", VertexAttrib);
+    program->bindAttributeLocation("normal", NormalAttrib);
+    program->bindAttributeLocation("instanceColor", InstanceColorAttrib);
+    program->bindAttributeLocation("blockMin", BlockMinAttrib);
+    program->bindAttributeLocation("blockSize", BlockSizeAttrib);
+    program->bindAttributeLocation("blockColor", BlockColorAttrib);
+    program->link();
+    m_cache->insertProgram(name, program);
+    return program;
+}
+
+void LatticeRenderer::initialize(bool core)
+{
+    initializeOpenGLFunctions();
+
+    // Instanced drawing needs glVertexAttribDivisor, which is core since
+    // OpenGL 3.3 and OpenGL ES 3.0. Older contexts draw one LED at a time.
+    QOpenGLContext *context = QOpenGLContext::currentContext();
+    const QSurfaceFormat ctxFormat = context->format();
+    m_instanced = context->isOpenGLES()
+            ? ctxFormat.majorVersion() >= 3
+            : ctxFormat.version() >= qMakePair(3, 3);
+
+    // Whatever an earlier context of the share group left is reused.
+    m_cache = GlResourceCache::current();
+    if (m_instanced) {
+        const QByteArray version = context->isOpenGLES()
+                ? QByteArrayLiteral("#version 300 es\n")
+                : QByteArrayLiteral("#version 330\n");
+        m_program = buildProgram("lattice.instanced", version + vertexShaderSourceInstanced,
+                                 version + fragmentShaderSourceInstanced);
+        m_blockProgram = buildProgram("lattice.blocks", version + vertexShaderSourceBlock,
+                                      version + fragmentShaderSourceInstanced);
+    } else if (core) {
+        m_program = buildProgram("lattice.core", vertexShaderSourceCore, fragmentShaderSourceCore);
+    } else {
+        m_program = buildProgram("lattice", vertexShaderSource, fragmentShaderSource);
+    }
+
+    m_projMatrixLoc = m_program->uniformLocation("projMatrix");
+    m_mvMatrixLoc = m_program->uniformLocation("mvMatrix");
+    m_normalMatrixLoc = m_program->uniformLocation("normalMatrix");
+    m_lightPosLoc = m_program->uniformLocation("lightPos");
+    // Custom shader variables:
+    m_colorLoc = m_program->uniformLocation("u_color");
+    m_offsetLoc = m_program->uniformLocation("u_offset");
+    m_colorOffLoc = m_program->uniformLocation("u_colorOff");
+    m_ledSizeLoc = m_program->uniformLocation("u_ledSize");
+    m_scaleLoc = m_program->uniformLocation("u_scale");
+    m_instanceBaseLoc = m_program->uniformLocation("u_instanceBase");
+    m_latticeSizeLoc = m_program->uniformLocation("u_latticeSize");
+    m_originLoc = m_program->uniformLocation("u_origin");
+    m_pitchLoc = m_program->uniformLocation("u_pitch");
+    m_gridColumnsLoc = m_program->uniformLocation("u_gridColumns");
+    m_gridOriginLoc = m_program->uniformLocation("u_gridOrigin");
+    m_gridSpacingLoc = m_program->uniformLocation("u_gridSpacing");
+
+    // Create a vertex array object. In OpenGL ES 2.0 and OpenGL 2.x
+    // implementations this is optional and support may not be present
+    // at all. Nonetheless the below code works in all cases and makes
+    // sure there is a VAO when one is needed. Unlike the buffers, VAOs
+    // are never shared between contexts.
+    m_vao.create();
+    QOpenGLVertexArrayObject::Binder vaoBinder(&m_vao);
+
+    // The mesh is the same for every cube size and every renderer, only
+    // the instance states grow with the LED count.
+    m_logoVbo = m_cache->meshVertexBuffer();
+    m_indexBuffer = m_cache->meshIndexBuffer();
+    m_indexBuffer.bind();
+
+    // Store the vertex attribute bindings for the program.
+    setupVertexAttribs();
+    if (m_instanced)
+        setupInstanceAttribs();
+
+    for (int lattice = 0; lattice < m_logos.size(); ++lattice)
+        m_lod.updateColors(lattice, 0, m_logos.at(lattice)->ledCount() - 1);
+    if (m_blockProgram)
+        setupBlockAttribs();
+}
+
+void LatticeRenderer::cleanup()
+{
+    if (m_program == nullptr)
+        return;
+    // Only what belongs to this context, the rest stays in the cache for
+    // the next context of the share group.
+    m_vao.destroy();
+    m_blockVao.destroy();
+    m_logoVbo = QOpenGLBuffer();
+    m_indexBuffer = QOpenGLBuffer(QOpenGLBuffer::IndexBuffer);
+    for (QOpenGLBuffer &vbo : m_stateVbo)
+        vbo = QOpenGLBuffer();
+    m_blockVbo = QOpenGLBuffer();
+    m_program = nullptr;
+    m_blockProgram = nullptr;
+}
+
+void LatticeRenderer::release()
+{
+    cleanup();
+    if (m_cache)
+        m_cache->release(this);
+}
+
+void LatticeRenderer::setupUniforms()
+{
+    // The program is shared by every renderer of the share group, so the
+    // lattice layout is set whenever this one draws.
+    // Light position is fixed.
+    m_program->setUniformValue(m_lightPosLoc, QVector3D(0, 0, 70));
+    m_program->setUniformValue(m_colorOffLoc, Vec3D_LightOff);
+    const Logo *logo = m_logos.first();
+    m_program->setUniformValue(m_ledSizeLoc, logo->ledSize());
+    m_program->setUniformValue(m_originLoc, logo->origin());
+    m_program->setUniformValue(m_pitchLoc, logo->pitch());
+    const CubeConfig &config = logo->config();
+    glUniform3i(m_latticeSizeLoc, config.sizeX, config.sizeY, config.sizeZ);
+    m_program->setUniformValue(m_gridColumnsLoc, gridColumns(m_logos.size()));
+    m_program->setUniformValue(m_gridOriginLoc, latticeOffset(0, m_logos.size()));
+    m_program->setUniformValue(m_gridSpacingLoc, LATTICE_GRID_SPACING);
+}
+
+void LatticeRenderer::setupVertexAttribs()
+{
+    m_logoVbo.bind();
+    QOpenGLFunctions *f = QOpenGLContext::currentContext()->functions();
+    f->glEnableVertexAttribArray(VertexAttrib);
+    f->glEnableVertexAttribArray(NormalAttrib);
+    f->glVertexAttribPointer(VertexAttrib, 3, GL_BYTE, GL_FALSE, sizeof(LedVertex),
+                             reinterpret_cast<void *>(offsetof(LedVertex, position)));
+    f->glVertexAttribPointer(NormalAttrib, 3, GL_BYTE, GL_TRUE, sizeof(LedVertex),
+                             reinterpret_cast<void *>(offsetof(LedVertex, normal)));
+    m_logoVbo.release();
+}
+
+void LatticeRenderer::setupInstanceAttribs()
+{
+    QOpenGLExtraFunctions *f = QOpenGLContext::currentContext()->extraFunctions();
+
+    // Buffers surviving in the cache are as current as their dirty ranges
+    // say. Only brand new ones need the complete state once.
+    for (int i = 0; i < STATE_BUFFER_COUNT; ++i)
+        m_stateVbo[i] = m_cache->buffer(this, QByteArray("state") + char('0' + i));
+    if (!m_stateVbo[0].isCreated()) {
+        m_instanceColors.resize(m_instanceCount);
+        quint32 *colors = m_instanceColors.data();
+        for (Logo *logo : m_logos) {
+            logo->fill_instance_colors(colors, 0, logo->instanceCount() - 1);
+            logo->clear_dirty();
+            colors += logo->instanceCount();
+        }
+        for (int i = 0; i < STATE_BUFFER_COUNT; ++i) {
+            m_stateVbo[i] = QOpenGLBuffer();
+            m_stateVbo[i].create();
+            m_stateVbo[i].setUsagePattern(QOpenGLBuffer::DynamicDraw);
+            m_stateVbo[i].bind();
+            m_stateVbo[i].allocate(m_instanceCount * sizeof(quint32));
+            m_stateVbo[i].release();
+            m_stateDirtyFirst[i] = 0;
+            m_stateDirtyLast[i] = m_instanceCount - 1;
+            m_cache->insertBuffer(this, QByteArray("state") + char('0' + i), m_stateVbo[i]);
+        }
+        m_stateIndex = 0;
+    }
+
+    m_stateVbo[m_stateIndex].bind();
+    f->glEnableVertexAttribArray(InstanceColorAttrib);
+    f->glVertexAttribPointer(InstanceColorAttrib, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(quint32),
+                             nullptr);
+    f->glVertexAttribDivisor(InstanceColorAttrib, 1);
+    m_stateVbo[m_stateIndex].release();
+}
+
+void LatticeRenderer::setupBlockAttribs()
+{
+    QOpenGLExtraFunctions *f = QOpenGLContext::currentContext()->extraFunctions();
+
+    m_blockVao.create();
+    QOpenGLVertexArrayObject::Binder vaoBinder(&m_blockVao);
+    m_indexBuffer.bind();
+    setupVertexAttribs();
+
+    // Refilled every frame with what LatticeLod merged.
+    m_blockVbo = m_cache->buffer(this, QByteArrayLiteral("blocks"));
+    if (!m_blockVbo.isCreated()) {
+        m_blockVbo.create();
+        m_blockVbo.setUsagePattern(QOpenGLBuffer::StreamDraw);
+        m_cache->insertBuffer(this, QByteArrayLiteral("blocks"), m_blockVbo);
+    }
+    m_blockVbo.bind();
+    f->glEnableVertexAttribArray(BlockMinAttrib);
+    f->glEnableVertexAttribArray(BlockSizeAttrib);
+    f->glEnableVertexAttribArray(BlockColorAttrib);
+    f->glVertexAttribPointer(BlockMinAttrib, 3, GL_FLOAT, GL_FALSE, sizeof(LatticeLod::Block),
+                             reinterpret_cast<void *>(offsetof(LatticeLod::Block, min)));
+    f->glVertexAttribPointer(BlockSizeAttrib, 3, GL_FLOAT, GL_FALSE, sizeof(LatticeLod::Block),
+                             reinterpret_cast<void *>(offsetof(LatticeLod::Block, size)));
+    f->glVertexAttribPointer(BlockColorAttrib, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(LatticeLod::Block),
+                             reinterpret_cast<void *>(offsetof(LatticeLod::Block, color)));
+    f->glVertexAttribDivisor(BlockMinAttrib, 1);
+    f->glVertexAttribDivisor(BlockSizeAttrib, 1);
+    f->glVertexAttribDivisor(BlockColorAttrib, 1);
+    m_blockVbo.release();
+
+}
+
+void LatticeRenderer::uploadInstanceColors()
+{
+    // One range covering the changes of every lattice.
+    int first = m_instanceCount;
+    int last = -1;
+    int base = 0;
+    for (int lattice = 0; lattice < m_logos.size(); ++lattice) {
+        Logo *logo = m_logos.at(lattice);
+        if (logo->isDirty()) {
+            logo->fill_instance_colors(m_instanceColors.data() + base, logo->dirtyFirst(), logo->dirtyLast());
+            m_lod.updateColors(lattice, logo->dirtyFirst(), logo->dirtyLast());
+            first = qMin(first, base + logo->dirtyFirst());
+            last = qMax(last, base + logo->dirtyLast());
+            logo->clear_dirty();
+        }
+        base += logo->instanceCount();
+    }
+
+    if (first <= last) {
+        // Every buffer has to catch up on this change before it is drawn from.
+        for (int i = 0; i < STATE_BUFFER_COUNT; ++i) {
+            m_stateDirtyFirst[i] = qMin(m_stateDirtyFirst[i], first);
+            m_stateDirtyLast[i] = qMax(m_stateDirtyLast[i], last);
+        }
+        m_stateIndex = (m_stateIndex + 1) % STATE_BUFFER_COUNT;
+    }
+
+    QOpenGLBuffer &vbo = m_stateVbo[m_stateIndex];
+    first = m_stateDirtyFirst[m_stateIndex];
+    last = m_stateDirtyLast[m_stateIndex];
+    if (first <= last) {
+        vbo.bind();
+        vbo.write(first * sizeof(quint32), m_instanceColors.constData() + first,
+                  (last - first + 1) * sizeof(quint32));
+        vbo.release();
+        m_stateDirtyFirst[m_stateIndex] = m_instanceCount;
+        m_stateDirtyLast[m_stateIndex] = -1;
+    }
+}
+
+void LatticeRenderer::render(const QMatrix4x4 &proj, const QMatrix4x4 &modelView, const QMatrix3x3 &normalMatrix)
+{
+    QMatrix4x4 gridModelView = modelView;
+    gridModelView.scale(gridScale(m_logos.size()));
+
+    if (m_instanced) {
+        uploadInstanceColors();
+    } else {
+        // Every LED is redrawn from the state model, only the block colors
+        // need the changes.
+        for (int lattice = 0; lattice < m_logos.size(); ++lattice) {
+            Logo *logo = m_logos.at(lattice);
+            if (logo->isDirty())
+                m_lod.updateColors(lattice, logo->dirtyFirst(), logo->dirtyLast());
+            logo->clear_dirty();
+        }
+    }
+    GLint viewport[4];
+    glGetIntegerv(GL_VIEWPORT, viewport);
+    m_lod.update(proj, gridModelView, QSize(viewport[2], viewport[3]));
+
+    m_drawCalls = 0;
+    {
+        QOpenGLVertexArrayObject::Binder vaoBinder(&m_vao);
+        m_program->bind();
+        setupUniforms();
+        m_program->setUniformValue(m_projMatrixLoc, proj);
+        m_program->setUniformValue(m_mvMatrixLoc, gridModelView);
+        m_program->setUniformValue(m_normalMatrixLoc, normalMatrix);
+
+        if (m_instanced)
+            paintInstanced();
+        else
+            paintPerLed();
+
+        m_program->release();
+    }
+
+    if (m_instanced && !m_lod.blocks().isEmpty())
+        paintBlocks(proj, gridModelView, normalMatrix);
+}
+
+void LatticeRenderer::paintInstanced()
+{
+    // Without a base instance on OpenGL ES, every run moves the start of
+    // the color attribute and tells the shader where it begins.
+    QOpenGLExtraFunctions *f = QOpenGLContext::currentContext()->extraFunctions();
+    m_stateVbo[m_stateIndex].bind();
+    for (const LatticeLod::Run &run : m_lod.runs()) {
+        f->glVertexAttribPointer(InstanceColorAttrib, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(quint32),
+                                 reinterpret_cast<void *>(qintptr(run.first) * sizeof(quint32)));
+        m_program->setUniformValue(m_instanceBaseLoc, run.first);
+        f->glDrawElementsInstanced(GL_TRIANGLES
+                                   ,Logo::meshIndexCount()
+                                   ,GL_UNSIGNED_BYTE
+                                   ,nullptr
+                                   ,run.count
+                                  );
+        ++m_drawCalls;
+    }
+    m_stateVbo[m_stateIndex].release();
+}
+
+void LatticeRenderer::paintBlocks(const QMatrix4x4 &proj, const QMatrix4x4 &modelView, const QMatrix3x3 &normalMatrix)
+{
+    QOpenGLExtraFunctions *f = QOpenGLContext::currentContext()->extraFunctions();
+    QOpenGLVertexArrayObject::Binder vaoBinder(&m_blockVao);
+    const QList<LatticeLod::Block> &blocks = m_lod.blocks();
+    m_blockVbo.bind();
+    m_blockVbo.allocate(blocks.constData(), blocks.size() * sizeof(LatticeLod::Block));
+    m_blockVbo.release();
+
+    m_blockProgram->bind();
+    m_blockProgram->setUniformValue("projMatrix", proj);
+    m_blockProgram->setUniformValue("mvMatrix", modelView);
+    m_blockProgram->setUniformValue("normalMatrix", normalMatrix);
+    m_blockProgram->setUniformValue("lightPos", QVector3D(0, 0, 70));
+    f->glDrawElementsInstanced(GL_TRIANGLES, Logo::meshIndexCount(), GL_UNSIGNED_BYTE, nullptr,
+                               blocks.size());
+    ++m_drawCalls;
+    m_blockProgram->release();
+}
+
+void LatticeRenderer::paintPerLed()
+{
+    const Logo *first = m_logos.first();
+    const int ledCount = first->ledCount();
+    const GLfloat ledSize = first->ledSize();
+    QList<QVector3D> offsets;
+    for (int lattice = 0; lattice < m_logos.size(); ++lattice)
+        offsets.append(latticeOffset(lattice, m_logos.size()));
+
+    m_program->setUniformValue(m_scaleLoc, QVector3D(ledSize, ledSize, ledSize));
+    for (const LatticeLod::Run &run : m_lod.runs())
+    {
+        for (int instance = run.first; instance < run.first + run.count; ++instance)
+        {
+            const int lattice = instance / ledCount;
+            const int i = instance % ledCount;
+            const Logo *logo = m_logos.at(lattice);
+            const quint32 packed = logo->color(i);
+            uchar rgba[4];
+            memcpy(rgba, &packed, sizeof(rgba));
+            const QVector3D color(rgba[0] / 255.0f, rgba[1] / 255.0f, rgba[2] / 255.0f);
+            const GLfloat intensity = rgba[3] / 255.0f;
+            m_program->setUniformValue(m_colorLoc, Vec3D_LightOff * (1.0f - intensity) + color * intensity);
+            m_program->setUniformValue(m_offsetLoc, offsets.at(lattice) + logo->ledPosition(i));
+
+            glDrawElements(GL_TRIANGLES                 // Draw mode
+                           ,Logo::meshIndexCount()      // Length
+                           ,GL_UNSIGNED_BYTE            // Index type
+                           ,nullptr                     // Start of the index buffer
+                          );
+            ++m_drawCalls;
+        }
+    }
+
+    // Merged bricks are boxes of the same program.
+    for (const LatticeLod::Block &block : m_lod.blocks())
+    {
+        uchar rgba[4];
+        memcpy(rgba, &block.color, sizeof(rgba));
+        m_program->setUniformValue(m_colorLoc, QVector3D(rgba[0] / 255.0f, rgba[1] / 255.0f, rgba[2] / 255.0f));
+        m_program->setUniformValue(m_offsetLoc, QVector3D(block.min[0], block.min[1], block.min[2]));
+        m_program->setUniformValue(m_scaleLoc, QVector3D(block.size[0], block.size[1], block.size[2]));
+        glDrawElements(GL_TRIANGLES, Logo::meshIndexCount(), GL_UNSIGNED_BYTE, nullptr);
+        ++m_drawCalls;
+    }
+}
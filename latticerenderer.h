@@ -0,0 +1,108 @@
+// Copyright (C) 2016 The Qt Company Ltd.
+// SPDX-License-Identifier: LicenseRef-Qt-Commercial OR BSD-3-Clause
+
+#ifndef LATTICERENDERER_H
+#define LATTICERENDERER_H
+
+#include <QOpenGLFunctions>
+#include <QOpenGLVertexArrayObject>
+#include <QOpenGLBuffer>
+#include <QMatrix4x4>
+#include <QPointer>
+#include "logo.h"
+#include "latticelod.h"
+#include "glresourcecache.h"
+
+// Instance color buffers cycled through so uploads never touch a buffer
+// the GPU may still be reading for a previous frame.
+#define STATE_BUFFER_COUNT 3
+// Distance between neighbouring lattices of a grid, each spans 0.4.
+#define LATTICE_GRID_SPACING 0.5f
+
+QT_FORWARD_DECLARE_CLASS(QOpenGLShaderProgram)
+
+/*
+ * Draws the LED lattice of a Logo into whatever context is current. Shared
+ * by GLWidget and the offscreen tools so they all measure and show the
+ * same rendering path. initialize(), render() and cleanup() must be called
+ * with the same context current.
+ *
+ * Several Logos of the same size are laid out as a grid of lattices,
+ * scaled to the size of a single one. The LED colors of all of them live
+ * in one RGBA8 instance buffer, updated with one write per frame, and the
+ * whole grid is drawn instanced, one call per run of LEDs LatticeLod
+ * leaves at full detail plus one for its merged blocks.
+ */
+class LatticeRenderer : protected QOpenGLFunctions
+{
+public:
+    explicit LatticeRenderer(Logo *logo);
+    explicit LatticeRenderer(const QList<Logo *> &logos);
+
+    // Grid position of a lattice and the scale fitting the grid into the
+    // space of one lattice.
+    static QVector3D latticeOffset(int lattice, int latticeCount);
+    static GLfloat gridScale(int latticeCount);
+
+    void initialize(bool core);
+    // Lets go of the context, what is shareable stays cached for the next
+    // one. release() also frees this renderer's state in the cache and
+    // wants a context of the share group current.
+    void cleanup();
+    void release();
+    bool isInitialized() const { return m_program != nullptr; }
+    bool isInstanced() const { return m_instanced; }
+
+    void render(const QMatrix4x4 &proj, const QMatrix4x4 &modelView, const QMatrix3x3 &normalMatrix);
+    int drawCalls() const { return m_drawCalls; }
+    const LatticeLod &lod() const { return m_lod; }
+
+private:
+    QOpenGLShaderProgram *buildProgram(const QByteArray &name, const QByteArray &vertexSource,
+                                       const QByteArray &fragmentSource);
+    void setupUniforms();
+    void setupVertexAttribs();
+    void setupInstanceAttribs();
+    void setupBlockAttribs();
+    void uploadInstanceColors();
+    void paintInstanced();
+    void paintBlocks(const QMatrix4x4 &proj, const QMatrix4x4 &modelView, const QMatrix3x3 &normalMatrix);
+    void paintPerLed();
+
+    QList<Logo *> m_logos;
+    int m_instanceCount = 0;
+    QPointer<GlResourceCache> m_cache;
+    QOpenGLVertexArrayObject m_vao;
+    QOpenGLBuffer m_logoVbo;
+    QOpenGLBuffer m_indexBuffer { QOpenGLBuffer::IndexBuffer };
+    QOpenGLBuffer m_stateVbo[STATE_BUFFER_COUNT];
+    int m_stateDirtyFirst[STATE_BUFFER_COUNT];
+    int m_stateDirtyLast[STATE_BUFFER_COUNT];
+    int m_stateIndex = 0;
+    bool m_instanced = false;
+    QList<quint32> m_instanceColors;
+    LatticeLod m_lod;
+    QOpenGLShaderProgram *m_program = nullptr;
+    QOpenGLShaderProgram *m_blockProgram = nullptr;
+    QOpenGLVertexArrayObject m_blockVao;
+    QOpenGLBuffer m_blockVbo;
+    int m_projMatrixLoc = 0;
+    int m_mvMatrixLoc = 0;
+    int m_normalMatrixLoc = 0;
+    int m_lightPosLoc = 0;
+    int m_colorLoc = 0;
+    int m_offsetLoc = 0;
+    int m_colorOffLoc = 0;
+    int m_ledSizeLoc = 0;
+    int m_scaleLoc = 0;
+    int m_instanceBaseLoc = 0;
+    int m_latticeSizeLoc = 0;
+    int m_originLoc = 0;
+    int m_pitchLoc = 0;
+    int m_gridColumnsLoc = 0;
+    int m_gridOriginLoc = 0;
+    int m_gridSpacingLoc = 0;
+    int m_drawCalls = 0;
+};
+
+#endif // LATTICERENDERER_H
@@ -2,204 +2,177 @@
 // SPDX-License-Identifier: LicenseRef-Qt-Commercial OR BSD-3-Clause
 
 #include "logo.h"
-#include <qmath.h>
-#include <QDebug>
-
-Logo::Logo()
+#include "frameparser.h"
+#include <QtAlgorithms>
+#include <cstring>
+
+// Lit LEDs of plain frames, the color lit LEDs always had.
+static const quint32 DefaultLedColor = ledColor(89, 230, 255, 255);
+
+// Unit cube, four vertices per face so every face has its own normal.
+// Faces wind counter-clockwise seen from outside.
+static constexpr LedVertex LedMeshVertices[24] = {
+    // -X
+    { { 0, 0, 0, 0 }, { -127, 0, 0, 0 } },
+    { { 0, 0, 1, 0 }, { -127, 0, 0, 0 } },
+    { { 0, 1, 1, 0 }, { -127, 0, 0, 0 } },
+    { { 0, 1, 0, 0 }, { -127, 0, 0, 0 } },
+    // +X
+    { { 1, 0, 0, 0 }, { 127, 0, 0, 0 } },
+    { { 1, 1, 0, 0 }, { 127, 0, 0, 0 } },
+    { { 1, 1, 1, 0 }, { 127, 0, 0, 0 } },
+    { { 1, 0, 1, 0 }, { 127, 0, 0, 0 } },
+    // -Y
+    { { 0, 0, 0, 0 }, { 0, -127, 0, 0 } },
+    { { 1, 0, 0, 0 }, { 0, -127, 0, 0 } },
+    { { 1, 0, 1, 0 }, { 0, -127, 0, 0 } },
+    { { 0, 0, 1, 0 }, { 0, -127, 0, 0 } },
+    // +Y
+    { { 0, 1, 0, 0 }, { 0, 127, 0, 0 } },
+    { { 0, 1, 1, 0 }, { 0, 127, 0, 0 } },
+    { { 1, 1, 1, 0 }, { 0, 127, 0, 0 } },
+    { { 1, 1, 0, 0 }, { 0, 127, 0, 0 } },
+    // -Z
+    { { 0, 0, 0, 0 }, { 0, 0, -127, 0 } },
+    { { 0, 1, 0, 0 }, { 0, 0, -127, 0 } },
+    { { 1, 1, 0, 0 }, { 0, 0, -127, 0 } },
+    { { 1, 0, 0, 0 }, { 0, 0, -127, 0 } },
+    // +Z
+    { { 0, 0, 1, 0 }, { 0, 0, 127, 0 } },
+    { { 1, 0, 1, 0 }, { 0, 0, 127, 0 } },
+    { { 1, 1, 1, 0 }, { 0, 0, 127, 0 } },
+    { { 0, 1, 1, 0 }, { 0, 0, 127, 0 } },
+};
+
+static constexpr GLubyte LedMeshIndices[36] = {
+     0,  1,  2,   0,  2,  3,
+     4,  5,  6,   4,  6,  7,
+     8,  9, 10,   8, 10, 11,
+    12, 13, 14,  12, 14, 15,
+    16, 17, 18,  16, 18, 19,
+    20, 21, 22,  20, 22, 23,
+};
+
+Logo::Logo(const CubeConfig &config)
+    : m_config(config)
 {
-
-    Cube_coords["X15"] = 0;
-    Cube_coords["X13"] = 1;
-    Cube_coords["X12"] = 2;
-    Cube_coords["X11"] = 3;
-    Cube_coords["X10"] = 4;
-
-    Cube_coords["Y14"] = 0;
-    Cube_coords["Y16"] = 1;
-    Cube_coords["Y17"] = 2;
-    Cube_coords["Y18"] = 3;
-    Cube_coords["Y19"] = 4;
-
-    Cube_coords["Z27"] = 0;
-    Cube_coords["Z26"] = 1;
-    Cube_coords["Z22"] = 2;
-    Cube_coords["Z21"] = 3;
-    Cube_coords["Z20"] = 4;
-
-    m_data.resize(MAX_LED_AMOUNT * 36 * 6);
-
-    const GLfloat x1 = +0.14f;
-    const GLfloat y1 = +0.14f;
-
-    const GLfloat x2 = +0.14f;
-    const GLfloat y2 = -0.14f;
-
-    const GLfloat x3 = -0.14f;
-    const GLfloat y3 = +0.14f;
-
-    const GLfloat x4 = -0.14f;
-    const GLfloat y4 = -0.14f;
-
-//    cube(-0.8f, +0.35f, -0.5f);
-    create_cube(-0.215f, -0.215f, -0.215f);
+    m_state.resize(m_config.ledCount());
+    m_changed.resize(m_config.ledCount());
+    m_colors.fill(0, m_config.ledCount());
+    clear_dirty();
+
+    // Keep the lattice the size of the original 5x5x5 cube whatever the LED
+    // count, LEDs take 30% of the pitch.
+    const GLfloat span = 0.4f;
+    m_pitch = m_config.maxSize() > 1 ? span / (m_config.maxSize() - 1) : 0.1f;
+    m_ledSize = m_pitch * 0.3f;
+    m_origin = QVector3D(-(m_config.sizeX - 1) * m_pitch / 2 - m_ledSize / 2,
+                         -(m_config.sizeY - 1) * m_pitch / 2 - m_ledSize / 2,
+                         -(m_config.sizeZ - 1) * m_pitch / 2 - m_ledSize / 2);
 }
 
-void Logo::clear_leds()
+const LedVertex *Logo::meshVertices()
 {
-    for (int i = 0; i < MAX_LEDS_X; ++i)
-    {
-        for (int j = 0; j < MAX_LEDS_Y; ++j)
-        {
-            for (int k = 0; k < MAX_LEDS_Z; ++k)
-            {
-                led_data[i][j][k].active = 0;
-            }
-        }
-    }
+    return LedMeshVertices;
 }
 
+const GLubyte *Logo::meshIndices()
+{
+    return LedMeshIndices;
+}
 
-void Logo::add(const QVector3D &v, const QVector3D &n)
+QVector3D Logo::ledPosition(int index) const
 {
-    GLfloat *p = m_data.data() + m_count;
-    *p++ = v.x();
-    *p++ = v.y();
-    *p++ = v.z();
-    *p++ = n.x();
-    *p++ = n.y();
-    *p++ = n.z();
-    m_count += 6;
+    const int z = index % m_config.sizeZ;
+    const int y = (index / m_config.sizeZ) % m_config.sizeY;
+    const int x = index / (m_config.sizeY * m_config.sizeZ);
+    return m_origin + m_pitch * QVector3D(x, y, z);
 }
 
-void Logo::create_led(GLfloat x, GLfloat y, GLfloat z, int x_idx, int y_idx, int z_idx)
+void Logo::layer(int x, quint64 *out) const
 {
-    const GLfloat offset = 0.03f;
-    QVector3D n = QVector3D::normal(
-                QVector3D(x, y, z)
-                ,QVector3D(x+offset, y+offset, z));
-
-    led_data[x_idx][y_idx][z_idx].startingVertex = vertexCount();
-    /* First wall */
-//    triangle
-    add(QVector3D(x, y, z), n);
-    add(QVector3D(x+offset, y, z), n);
-    add(QVector3D(x+offset, y+offset, z), n);
-
-//    triangle
-    add(QVector3D(x, y, z), n);
-    add(QVector3D(x+offset, y+offset, z), n);
-    add(QVector3D(x, y+offset, z), n);
-
-    /* Second wall */
-    add(QVector3D(x+offset, y+offset, z), n);
-    add(QVector3D(x+offset, y, z), n);
-    add(QVector3D(x+offset, y+offset, z+offset), n);
-
-    add(QVector3D(x+offset, y+offset, z+offset), n);
-    add(QVector3D(x+offset, y, z), n);
-    add(QVector3D(x+offset, y, z+offset), n);
-
-    /* Third wall */
-    add(QVector3D(x+offset, y+offset, z+offset), n);
-    add(QVector3D(x+offset, y, z+offset), n);
-    add(QVector3D(x, y+offset, z+offset), n);
-
-    add(QVector3D(x, y, z+offset), n);
-    add(QVector3D(x, y+offset, z+offset), n);
-    add(QVector3D(x+offset, y, z+offset), n);
-
-    /* Fourth wall */
-    add(QVector3D(x, y, z), n);
-    add(QVector3D(x+offset, y, z+offset), n);
-    add(QVector3D(x+offset, y, z), n);
-
-    add(QVector3D(x, y, z), n);
-    add(QVector3D(x, y, z+offset), n);
-    add(QVector3D(x+offset, y, z+offset), n);
-
-    /* Fifth wall */
-    add(QVector3D(x, y, z), n);
-    add(QVector3D(x, y+offset, z), n);
-    add(QVector3D(x, y, z+offset), n);
-
-    add(QVector3D(x, y+offset, z), n);
-    add(QVector3D(x, y+offset, z+offset), n);
-    add(QVector3D(x, y, z+offset), n);
-
-    /* Sixth wall */
-    add(QVector3D(x, y+offset, z), n);
-    add(QVector3D(x+offset, y+offset, z), n);
-    add(QVector3D(x+offset, y+offset, z+offset), n);
-
-    add(QVector3D(x, y+offset, z+offset), n);
-    add(QVector3D(x, y+offset, z), n);
-    add(QVector3D(x+offset, y+offset, z+offset), n);
+    const int count = m_config.sizeY * m_config.sizeZ;
+    m_state.extractRange(x * count, count, out);
 }
 
-void Logo::create_cube(GLfloat x, GLfloat y, GLfloat z)
+void Logo::clear_leds()
 {
-    const GLfloat offset = 0.1f;
-    for (int i = 0; i < MAX_LEDS_X; ++i)
-    {
-        for (int j = 0; j < MAX_LEDS_Y; ++j)
-        {
-            for (int k = 0; k < MAX_LEDS_Z; ++k)
-            {
-                create_led(x+i*offset, y+j*offset, z+k*offset, i, j, k);
-//                qDebug()
-//                << "X="<< i
-//                << "Y="<< j
-//                << "Z="<< k
-//                << "| "<< led_data[i][j][k].startingVertex
-//                << " -> " << led_data[i][j][k].endingVertex << "|"
-//                << m_count << "|";
+    markDirty(m_state);
+    if (m_colored)
+        markDirtyRange(0, ledCount() - 1);
+    m_colors.fill(0);
+    m_colored = false;
+    m_state.clear();
+}
 
+bool Logo::apply(const LedFrame &frame)
+{
+    const bool bitsChanged = VoxelGrid::difference(m_state, frame.active, &m_changed);
+    bool changed = bitsChanged;
+
+    if (frame.colored) {
+        // Only the span between the first and the last changed color is
+        // copied and uploaded.
+        const quint32 *src = frame.colors.constData();
+        quint32 *dst = m_colors.data();
+        int first = 0;
+        int last = ledCount() - 1;
+        while (first <= last && dst[first] == src[first])
+            ++first;
+        while (last >= first && dst[last] == src[last])
+            --last;
+        if (first <= last) {
+            memcpy(dst + first, src + first, (last - first + 1) * sizeof(quint32));
+            markDirtyRange(first, last);
+            changed = true;
+        }
+    } else if (m_colored) {
+        // Back to plain frames, every LED takes the default look again.
+        for (int i = 0; i < ledCount(); ++i)
+            m_colors[i] = frame.active.test(i) ? DefaultLedColor : 0;
+        markDirtyRange(0, ledCount() - 1);
+        changed = true;
+    } else if (bitsChanged) {
+        const quint64 *words = m_changed.constData();
+        for (int w = 0; w < m_changed.wordCount(); ++w) {
+            for (quint64 bits = words[w]; bits; bits &= bits - 1) {
+                const int led = w * 64 + qCountTrailingZeroBits(bits);
+                m_colors[led] = frame.active.test(led) ? DefaultLedColor : 0;
             }
         }
     }
-}
+    m_colored = frame.colored;
 
-void Logo::rectangle(GLfloat x1, GLfloat y1, GLfloat x2, GLfloat y2, GLfloat x3, GLfloat y3, GLfloat x4, GLfloat y4, GLfloat z)
-{
-    QVector3D n = QVector3D::normal(QVector3D(x4 - x1, y4 - y1, z), QVector3D(x2 - x1, y2 - y1, z));
-    add(QVector3D(x1, y1, z), -n);
-    add(QVector3D(x2, y2, z), -n);
-    add(QVector3D(x3, y3, z), -n);
-    add(QVector3D(x4, y4, z), -n);
+    if (bitsChanged) {
+        markDirty(m_changed);
+        m_state.copyFrom(frame.active);
+    }
+    return changed;
 }
 
-void Logo::quad(GLfloat x1, GLfloat y1, GLfloat x2, GLfloat y2, GLfloat x3, GLfloat y3, GLfloat x4, GLfloat y4)
+void Logo::markDirty(const VoxelGrid &changed)
 {
-    QVector3D n = QVector3D::normal(QVector3D(x4 - x1, y4 - y1, 0.0f), QVector3D(x2 - x1, y2 - y1, 0.0f));
-
-    add(QVector3D(x1, y1, -0.05f), n);
-    add(QVector3D(x4, y4, -0.05f), n);
-    add(QVector3D(x2, y2, -0.05f), n);
+    const int first = changed.firstSetBit();
+    if (first < 0)
+        return;
 
-    add(QVector3D(x3, y3, -0.05f), n);
-    add(QVector3D(x2, y2, -0.05f), n);
-    add(QVector3D(x4, y4, -0.05f), n);
-
-    n = QVector3D::normal(QVector3D(x1 - x4, y1 - y4, 0.0f), QVector3D(x2 - x4, y2 - y4, 0.0f));
-
-    add(QVector3D(x4, y4, 0.05f), n);
-    add(QVector3D(x1, y1, 0.05f), n);
-    add(QVector3D(x2, y2, 0.05f), n);
-
-    add(QVector3D(x2, y2, 0.05f), n);
-    add(QVector3D(x3, y3, 0.05f), n);
-    add(QVector3D(x4, y4, 0.05f), n);
+    m_dirtyFirst = qMin(m_dirtyFirst, first);
+    m_dirtyLast = qMax(m_dirtyLast, changed.lastSetBit());
 }
 
-void Logo::extrude(GLfloat x1, GLfloat y1, GLfloat x2, GLfloat y2)
+void Logo::markDirtyRange(int first, int last)
 {
-    QVector3D n = QVector3D::normal(QVector3D(0.0f, 0.0f, -0.1f), QVector3D(x2 - x1, y2 - y1, 0.0f));
+    m_dirtyFirst = qMin(m_dirtyFirst, first);
+    m_dirtyLast = qMax(m_dirtyLast, last);
+}
 
-    add(QVector3D(x1, y1, +0.05f), n);
-    add(QVector3D(x1, y1, -0.05f), n);
-    add(QVector3D(x2, y2, +0.05f), n);
+void Logo::clear_dirty()
+{
+    m_dirtyFirst = ledCount();
+    m_dirtyLast = -1;
+}
 
-    add(QVector3D(x2, y2, -0.05f), n);
-    add(QVector3D(x2, y2, +0.05f), n);
-    add(QVector3D(x1, y1, -0.05f), n);
+void Logo::fill_instance_colors(quint32 *colors, int first, int last) const
+{
+    memcpy(colors + first, m_colors.constData() + first, (last - first + 1) * sizeof(quint32));
 }
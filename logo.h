@@ -6,64 +6,83 @@
 
 #include <qopengl.h>
 #include <QList>
-#include <QMap>
 #include <QVector3D>
+#include "cubeconfig.h"
+#include "voxelgrid.h"
 
-#define MAX_LEDS_X 5
-#define MAX_LEDS_Y 5
-#define MAX_LEDS_Z 5
-#define MAX_LED_AMOUNT 125
+struct LedFrame;
 
-#define X0 15U
-#define X1 13U
-#define X2 12U
-#define X3 11U
-#define X4 10U
-#define Y0 14U
-#define Y1 16U
-#define Y2 17U
-#define Y3 18U
-#define Y4 19U
-#define Z0 27U
-#define Z1 26U
-#define Z2 22U
-#define Z3 21U
-#define Z4 20U
-
-const unsigned int X_table[MAX_LEDS_X] = {X0, X1, X2, X3, X4};
-const unsigned int Y_table[MAX_LEDS_Y] = {Y0, Y1, Y2, Y3, Y4};
-const unsigned int Z_table[MAX_LEDS_Z] = {Z0, Z1, Z2, Z3, Z4};
-
-struct Led
+// Packed mesh vertex: unit cube corner and face normal, one byte per
+// component, padded to four.
+struct LedVertex
 {
-    int startingVertex;
-    int active = 0;
+    qint8 position[4];
+    qint8 normal[4];
 };
 
 class Logo
 {
 public:
-    Logo();
-    const GLfloat *constData() const { return m_data.constData(); }
-    int count() const { return m_count; }
-    int vertexCount() const { return m_count / 6; }
+    explicit Logo(const CubeConfig &config = CubeConfig::current());
+
+    const CubeConfig &config() const { return m_config; }
+    int ledCount() const { return m_state.size(); }
+    bool isActive(int index) const { return m_state.test(index); }
+    bool isActive(int x, int y, int z) const { return m_state.test(m_config.index(x, y, z)); }
+    // What the LED shows as ledColor() bytes: the frame's color, or for
+    // plain frames a default color at full intensity when lit, zero when
+    // not.
+    quint32 color(int index) const { return m_colors.at(index); }
+    const quint32 *colors() const { return m_colors.constData(); }
+    // False when every color follows from the LED bits alone.
+    bool isColored() const { return m_colored; }
+    // Bits of layer x, LED (y, z) at bit y * sizeZ + z. Needs room for
+    // (sizeY * sizeZ + 63) / 64 words.
+    void layer(int x, quint64 *out) const;
     void clear_leds();
+    bool apply(const LedFrame &frame);
+
+    // LEDs changed since the last clear_dirty(), as the inclusive range
+    // of linear LED indices covering them.
+    bool isDirty() const { return m_dirtyFirst <= m_dirtyLast; }
+    int dirtyFirst() const { return m_dirtyFirst; }
+    int dirtyLast() const { return m_dirtyLast; }
+    void clear_dirty();
+    // Everything dirty, e.g. for a renderer whose copy went stale.
+    void mark_dirty() { markDirtyRange(0, ledCount() - 1); }
 
-    //Variables
-    Led led_data[MAX_LEDS_X][MAX_LEDS_Y][MAX_LEDS_Z];
-    QMap<QString, unsigned int> Cube_coords;
+    // Every LED is the same indexed unit cube, scaled by ledSize() and
+    // moved to its lattice position. Positions are computed, LED n sits at
+    // origin() + pitch() * (x, y, z) for n = (x * sizeY + y) * sizeZ + z.
+    static const LedVertex *meshVertices();
+    static int meshVertexCount() { return 24; }
+    static const GLubyte *meshIndices();
+    static int meshIndexCount() { return 36; }
+    QVector3D origin() const { return m_origin; }
+    GLfloat pitch() const { return m_pitch; }
+    GLfloat ledSize() const { return m_ledSize; }
+    QVector3D ledPosition(int index) const;
+
+    int instanceCount() const { return ledCount(); }
+    void fill_instance_colors(quint32 *colors, int first, int last) const;
 
 private:
-    int activate_led(int X, int Y, int Z);
-    void add(const QVector3D &v, const QVector3D &n);
-    void create_led(GLfloat x, GLfloat y, GLfloat z, int x_idx, int y_idx, int z_idx);
-    void create_cube(GLfloat x, GLfloat y, GLfloat z);
-    void rectangle(GLfloat x1, GLfloat y1, GLfloat x2, GLfloat y2, GLfloat x3, GLfloat y3, GLfloat x4, GLfloat y4, GLfloat z);
-    void quad(GLfloat x1, GLfloat y1, GLfloat x2, GLfloat y2, GLfloat x3, GLfloat y3, GLfloat x4, GLfloat y4);
-    void extrude(GLfloat x1, GLfloat y1, GLfloat x2, GLfloat y2);
+    void markDirty(const VoxelGrid &changed);
+    void markDirtyRange(int first, int last);
+
+    // One bit per LED, the only state touched per frame.
+    VoxelGrid m_state;
+    VoxelGrid m_changed;
+    QList<quint32> m_colors;
+    bool m_colored = false;
+
+    CubeConfig m_config;
+    QVector3D m_origin;
+    GLfloat m_pitch;
+    GLfloat m_ledSize;
 
-    QList<GLfloat> m_data;
-    int m_count = 0;
+    int m_dirtyFirst = 0;
+    int m_dirtyLast = -1;
 };
 
 #endif // LOGO_H
@@ -9,9 +9,49 @@
 
 #include "glwidget.h"
 #include "mainwindow.h"
+#include "cubeconfig.h"
+
+// Options needed before the application exists, "-name" or "--name".
+static bool hasArgument(int argc, char *argv[], const char *name)
+{
+    for (int i = 1; i < argc; ++i) {
+        const char *arg = argv[i];
+        while (*arg == '-')
+            ++arg;
+        if (arg != argv[i] && qstrcmp(arg, name) == 0)
+            return true;
+    }
+    return false;
+}
+
+// A whole number of at least minimum, warns about anything else.
+static bool intValue(const QCommandLineParser &parser, const QCommandLineOption &option, int minimum, int *value)
+{
+    bool ok = false;
+    *value = parser.value(option).toInt(&ok);
+    if (ok && *value >= minimum)
+        return true;
+    qWarning("Invalid --%s \"%s\"", qPrintable(option.names().constFirst()), qPrintable(parser.value(option)));
+    return false;
+}
 
 int main(int argc, char *argv[])
 {
+    // Every GLWidget context shares with the global share context, made
+    // along with the application in the default format. GPU resources then
+    // survive docking and undocking and are there for new windows.
+    QSurfaceFormat fmt;
+    fmt.setDepthBufferSize(24);
+    if (hasArgument(argc, argv, "multisample"))
+        fmt.setSamples(4);
+    if (hasArgument(argc, argv, "coreprofile")) {
+        // 3.3 for instanced drawing, the renderers check what they got.
+        fmt.setVersion(3, 3);
+        fmt.setProfile(QSurfaceFormat::CoreProfile);
+    }
+    QSurfaceFormat::setDefaultFormat(fmt);
+    QCoreApplication::setAttribute(Qt::AA_ShareOpenGLContexts);
+
     QApplication app(argc, argv);
 
     QCoreApplication::setApplicationName("Qt Hello GL 2 Example");
@@ -27,18 +67,147 @@ int main(int argc, char *argv[])
     parser.addOption(coreProfileOption);
     QCommandLineOption transparentOption("transparent", "Transparent window");
     parser.addOption(transparentOption);
+    QCommandLineOption textProtocolOption("textprotocol", "Do not request the binary frame protocol");
+    parser.addOption(textProtocolOption);
+    QCommandLineOption cubeConfigOption("cubeconfig", "Load cube dimensions and pin maps from <file>", "file");
+    parser.addOption(cubeConfigOption);
+    QCommandLineOption cubeSizeOption("cubesize", "Cube dimensions, e.g. 8 or 16x16x8", "size");
+    parser.addOption(cubeSizeOption);
+    QCommandLineOption hostOption("host", "Device address", "host", FrameReceiver::hostName());
+    parser.addOption(hostOption);
+    QCommandLineOption portOption("port", "Device port", "port", QString::number(FrameReceiver::port()));
+    parser.addOption(portOption);
+    QCommandLineOption deviceOption("device", "Connect to the cube at <host:port>, repeat for several cubes", "host:port");
+    parser.addOption(deviceOption);
+    QCommandLineOption deviceThreadsOption("devicethreads", "Threads receiving and decoding frames, 0 for one per core", "threads", "0");
+    parser.addOption(deviceThreadsOption);
+    QCommandLineOption windowOption("window", "Frames the device may send ahead of acknowledgement, 1 for stop-and-wait", "frames", "1");
+    parser.addOption(windowOption);
+    QCommandLineOption playoutDelayOption("playoutdelay", "Delay between frame arrival and display", "ms",
+                                          QString::number(FramePacer::defaultPlayoutDelay()));
+    parser.addOption(playoutDelayOption);
+    QCommandLineOption pacingOption("pacing", "What to do with several due frames: drop, coalesce or slowdown", "policy", "drop");
+    parser.addOption(pacingOption);
+    QCommandLineOption recordOption("record", "Record every received frame to <file>", "file");
+    parser.addOption(recordOption);
+    QCommandLineOption replayOption("replay", "Replay a recorded session instead of connecting to the device", "file");
+    parser.addOption(replayOption);
+    QCommandLineOption replaySpeedOption("replayspeed", "Replay speed factor, 0 for as fast as possible", "factor", "1");
+    parser.addOption(replaySpeedOption);
+    QCommandLineOption demoOption("demo", "Show a built-in pattern instead of connecting: sweep, rain, spheres or random", "pattern");
+    parser.addOption(demoOption);
+    QCommandLineOption demoRateOption("demorate", "Demo frames per second, 0 for as fast as they are shown", "fps", "30");
+    parser.addOption(demoRateOption);
+    QCommandLineOption demoDensityOption("demodensity", "Ratio of lit LEDs for rain and random", "ratio",
+                                         QString::number(PatternEngine::defaultDensity()));
+    parser.addOption(demoDensityOption);
+    QCommandLineOption renderOption("render", "How LEDs are drawn: mesh or volume, toggled with V", "mode", "mesh");
+    parser.addOption(renderOption);
+    QCommandLineOption lodOption("lod", "Draw bricks of LEDs smaller than <pixels> on screen as one block, 0 to disable", "pixels",
+                                 QString::number(LatticeLod::threshold()));
+    parser.addOption(lodOption);
+    QCommandLineOption renderThreadOption("renderthread", "Draw on a render thread, the window only composites its frames");
+    parser.addOption(renderThreadOption);
+    QCommandLineOption inertiaOption("inertia", "Keep turning the cube after a drag is released");
+    parser.addOption(inertiaOption);
+    QCommandLineOption captureOption("capture", "Capture frames into <directory>/window-n, toggled with C", "directory");
+    parser.addOption(captureOption);
+    QCommandLineOption captureFormatOption("captureformat", "Captured frames as png, jpg or raw", "format", "png");
+    parser.addOption(captureFormatOption);
+    QCommandLineOption statsOption("stats", "Show pipeline statistics, toggled with I");
+    parser.addOption(statsOption);
+    QCommandLineOption statsFileOption("statsfile", "File written when J is pressed", "file", GLWidget::statsFile());
+    parser.addOption(statsFileOption);
 
     parser.process(app);
 
-    QSurfaceFormat fmt;
-    fmt.setDepthBufferSize(24);
-    if (parser.isSet(multipleSampleOption))
-        fmt.setSamples(4);
-    if (parser.isSet(coreProfileOption)) {
-        fmt.setVersion(3, 2);
-        fmt.setProfile(QSurfaceFormat::CoreProfile);
+    FrameReceiver::setBinaryProtocol(!parser.isSet(textProtocolOption));
+    bool portOk = false;
+    const quint16 port = parser.value(portOption).toUShort(&portOk);
+    if (!portOk || port == 0) {
+        qWarning("Invalid port \"%s\"", qPrintable(parser.value(portOption)));
+        return 1;
     }
-    QSurfaceFormat::setDefaultFormat(fmt);
+    FrameReceiver::setEndpoint(parser.value(hostOption), port);
+    int window;
+    int playoutDelay;
+    int deviceThreads;
+    if (!intValue(parser, windowOption, 1, &window)
+            || !intValue(parser, playoutDelayOption, 0, &playoutDelay)
+            || !intValue(parser, deviceThreadsOption, 0, &deviceThreads)) {
+        return 1;
+    }
+    FrameReceiver::setWindowSize(window);
+    FramePacer::setDefaultPlayoutDelay(playoutDelay);
+    FramePacer::Policy pacing;
+    if (!FramePacer::policyFromString(parser.value(pacingOption), &pacing)) {
+        qWarning("Unknown pacing policy \"%s\"", qPrintable(parser.value(pacingOption)));
+        return 1;
+    }
+    FramePacer::setDefaultPolicy(pacing);
+    QList<DevicePool::Device> devices;
+    for (const QString &text : parser.values(deviceOption)) {
+        DevicePool::Device device;
+        QString error;
+        if (!DevicePool::deviceFromString(text, &device, &error)) {
+            qWarning("%s", qPrintable(error));
+            return 1;
+        }
+        devices.append(device);
+    }
+    if (devices.size() > 1 && (parser.isSet(recordOption) || parser.isSet(replayOption))) {
+        qWarning("Recording and replay need a single device");
+        return 1;
+    }
+    DevicePool::setDevices(devices);
+    DevicePool::setThreadCount(deviceThreads);
+    FrameReceiver::setRecordFile(parser.value(recordOption));
+    FrameReceiver::setReplayFile(parser.value(replayOption), parser.value(replaySpeedOption).toDouble());
+    if (parser.isSet(demoOption)) {
+        PatternEngine::Pattern pattern;
+        if (!PatternEngine::patternFromString(parser.value(demoOption), &pattern)) {
+            qWarning("Unknown demo pattern \"%s\"", qPrintable(parser.value(demoOption)));
+            return 1;
+        }
+        FrameReceiver::setDemo(parser.value(demoOption), parser.value(demoRateOption).toDouble());
+        PatternEngine::setDefaultDensity(parser.value(demoDensityOption).toDouble());
+    }
+    GLWidget::RenderMode renderMode;
+    if (!GLWidget::renderModeFromString(parser.value(renderOption), &renderMode)) {
+        qWarning("Unknown render mode \"%s\"", qPrintable(parser.value(renderOption)));
+        return 1;
+    }
+    GLWidget::setDefaultRenderMode(renderMode);
+    bool lodOk = false;
+    const float lod = parser.value(lodOption).toFloat(&lodOk);
+    if (!lodOk || lod < 0) {
+        qWarning("Invalid --lod \"%s\"", qPrintable(parser.value(lodOption)));
+        return 1;
+    }
+    LatticeLod::setThreshold(lod);
+    GLWidget::setThreadedRendering(parser.isSet(renderThreadOption));
+    GLWidget::setInertia(parser.isSet(inertiaOption));
+    FrameCapture::Format captureFormat;
+    if (!FrameCapture::formatFromString(parser.value(captureFormatOption), &captureFormat)) {
+        qWarning("Unknown capture format \"%s\"", qPrintable(parser.value(captureFormatOption)));
+        return 1;
+    }
+    GLWidget::setCaptureFormat(captureFormat);
+    GLWidget::setCaptureDirectory(parser.value(captureOption));
+    GLWidget::setDefaultStatsOverlay(parser.isSet(statsOption));
+    GLWidget::setStatsFile(parser.value(statsFileOption));
+
+    CubeConfig cubeConfig;
+    QString error;
+    if (parser.isSet(cubeConfigOption) && !cubeConfig.load(parser.value(cubeConfigOption), &error)) {
+        qWarning("Cannot load cube config: %s", qPrintable(error));
+        return 1;
+    }
+    if (parser.isSet(cubeSizeOption) && !cubeConfig.setSize(parser.value(cubeSizeOption), &error)) {
+        qWarning("%s", qPrintable(error));
+        return 1;
+    }
+    CubeConfig::setCurrent(cubeConfig);
 
     MainWindow mainWindow;
 
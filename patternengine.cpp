@@ -0,0 +1,325 @@
+// Copyright (C) 2016 The Qt Company Ltd.
+// SPDX-License-Identifier: LicenseRef-Qt-Commercial OR BSD-3-Clause
+
+#include "patternengine.h"
+
+#if defined(VOXEL_AVX2)
+#include <immintrin.h>
+#elif defined(VOXEL_SSE2)
+#include <emmintrin.h>
+#endif
+
+double PatternEngine::m_defaultDensity = 0.2;
+
+// dst = src >> shift as one long integer, 0 <= shift < 64. Works in place.
+static void shiftDown(quint64 *dst, const quint64 *src, int words, int shift)
+{
+    int i = 0;
+#if defined(VOXEL_AVX2)
+    const __m128i right = _mm_cvtsi32_si128(shift);
+    const __m128i left = _mm_cvtsi32_si128(64 - shift);
+    for (; i + 4 < words; i += 4) {
+        const __m256i low = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(src + i));
+        const __m256i high = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(src + i + 1));
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(dst + i),
+                            _mm256_or_si256(_mm256_srl_epi64(low, right), _mm256_sll_epi64(high, left)));
+    }
+#elif defined(VOXEL_SSE2)
+    const __m128i right = _mm_cvtsi32_si128(shift);
+    const __m128i left = _mm_cvtsi32_si128(64 - shift);
+    for (; i + 2 < words; i += 2) {
+        const __m128i low = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + i));
+        const __m128i high = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + i + 1));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + i),
+                         _mm_or_si128(_mm_srl_epi64(low, right), _mm_sll_epi64(high, left)));
+    }
+#endif
+    for (; i < words; ++i) {
+        const quint64 high = i + 1 < words && shift ? src[i + 1] << (64 - shift) : 0;
+        dst[i] = (src[i] >> shift) | high;
+    }
+}
+
+// dst = (dst & ~mask) | (src & mask), words a multiple of the block size.
+static void blend(quint64 *dst, const quint64 *src, const quint64 *mask, int words)
+{
+#if defined(VOXEL_AVX2)
+    for (int i = 0; i < words; i += 4) {
+        __m256i *d = reinterpret_cast<__m256i *>(dst + i);
+        const __m256i m = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(mask + i));
+        const __m256i s = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(src + i));
+        _mm256_storeu_si256(d, _mm256_or_si256(_mm256_andnot_si256(m, _mm256_loadu_si256(d)),
+                                               _mm256_and_si256(s, m)));
+    }
+#elif defined(VOXEL_SSE2)
+    for (int i = 0; i < words; i += 2) {
+        __m128i *d = reinterpret_cast<__m128i *>(dst + i);
+        const __m128i m = _mm_loadu_si128(reinterpret_cast<const __m128i *>(mask + i));
+        const __m128i s = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + i));
+        _mm_storeu_si128(d, _mm_or_si128(_mm_andnot_si128(m, _mm_loadu_si128(d)), _mm_and_si128(s, m)));
+    }
+#else
+    for (int i = 0; i < words; ++i)
+        dst[i] = (dst[i] & ~mask[i]) | (src[i] & mask[i]);
+#endif
+}
+
+#if defined(VOXEL_AVX2)
+static inline __m256i xorshift(__m256i x)
+{
+    x = _mm256_xor_si256(x, _mm256_slli_epi32(x, 13));
+    x = _mm256_xor_si256(x, _mm256_srli_epi32(x, 17));
+    return _mm256_xor_si256(x, _mm256_slli_epi32(x, 5));
+}
+#elif defined(VOXEL_SSE2)
+static inline __m128i xorshift(__m128i x)
+{
+    x = _mm_xor_si128(x, _mm_slli_epi32(x, 13));
+    x = _mm_xor_si128(x, _mm_srli_epi32(x, 17));
+    return _mm_xor_si128(x, _mm_slli_epi32(x, 5));
+}
+#endif
+
+static inline quint32 xorshift(quint32 x)
+{
+    x ^= x << 13;
+    x ^= x >> 17;
+    return x ^ (x << 5);
+}
+
+// Every bit set with probability threshold / 256: one random byte per bit,
+// compared against the threshold, the byte mask is the bit pattern.
+static void fillRandom(quint64 *dst, int words, int threshold, quint32 *lanes)
+{
+    if (threshold <= 0 || threshold >= 256) {
+        const quint64 fill = threshold <= 0 ? 0 : ~Q_UINT64_C(0);
+        for (int i = 0; i < words; ++i)
+            dst[i] = fill;
+        return;
+    }
+
+#if defined(VOXEL_AVX2)
+    const __m256i limit = _mm256_set1_epi8(char(threshold - 1));
+    __m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(lanes));
+    for (int i = 0; i < words; ++i) {
+        quint64 word = 0;
+        for (int part = 0; part < 2; ++part) {
+            x = xorshift(x);
+            const __m256i hit = _mm256_cmpeq_epi8(_mm256_min_epu8(x, limit), x);
+            word |= quint64(quint32(_mm256_movemask_epi8(hit))) << (32 * part);
+        }
+        dst[i] = word;
+    }
+    _mm256_storeu_si256(reinterpret_cast<__m256i *>(lanes), x);
+#elif defined(VOXEL_SSE2)
+    const __m128i limit = _mm_set1_epi8(char(threshold - 1));
+    __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i *>(lanes));
+    for (int i = 0; i < words; ++i) {
+        quint64 word = 0;
+        for (int part = 0; part < 4; ++part) {
+            x = xorshift(x);
+            const __m128i hit = _mm_cmpeq_epi8(_mm_min_epu8(x, limit), x);
+            word |= quint64(quint16(_mm_movemask_epi8(hit))) << (16 * part);
+        }
+        dst[i] = word;
+    }
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(lanes), x);
+#else
+    quint32 x = lanes[0];
+    for (int i = 0; i < words; ++i) {
+        quint64 word = 0;
+        for (int part = 0; part < 16; ++part) {
+            x = xorshift(x);
+            for (int byte = 0; byte < 4; ++byte) {
+                if (int((x >> (8 * byte)) & 0xff) < threshold)
+                    word |= Q_UINT64_C(1) << (part * 4 + byte);
+            }
+        }
+        dst[i] = word;
+    }
+    lanes[0] = x;
+#endif
+}
+
+// Bits z of one row with inner <= (z - cz)^2 + d2 < outer, count <= 64.
+static quint64 shellRow(float d2, float cz, float inner, float outer, int count)
+{
+    quint64 bits = 0;
+#if defined(VOXEL_AVX2)
+    const __m256 lane = _mm256_setr_ps(0, 1, 2, 3, 4, 5, 6, 7);
+    const __m256 innerV = _mm256_set1_ps(inner);
+    const __m256 outerV = _mm256_set1_ps(outer);
+    for (int z = 0; z < count; z += 8) {
+        const __m256 dz = _mm256_sub_ps(_mm256_add_ps(_mm256_set1_ps(float(z)), lane), _mm256_set1_ps(cz));
+        const __m256 d = _mm256_add_ps(_mm256_mul_ps(dz, dz), _mm256_set1_ps(d2));
+        const __m256 hit = _mm256_and_ps(_mm256_cmp_ps(d, innerV, _CMP_GE_OQ),
+                                         _mm256_cmp_ps(d, outerV, _CMP_LT_OQ));
+        bits |= quint64(_mm256_movemask_ps(hit)) << z;
+    }
+#elif defined(VOXEL_SSE2)
+    const __m128 lane = _mm_setr_ps(0, 1, 2, 3);
+    const __m128 innerV = _mm_set1_ps(inner);
+    const __m128 outerV = _mm_set1_ps(outer);
+    for (int z = 0; z < count; z += 4) {
+        const __m128 dz = _mm_sub_ps(_mm_add_ps(_mm_set1_ps(float(z)), lane), _mm_set1_ps(cz));
+        const __m128 d = _mm_add_ps(_mm_mul_ps(dz, dz), _mm_set1_ps(d2));
+        const __m128 hit = _mm_and_ps(_mm_cmpge_ps(d, innerV), _mm_cmplt_ps(d, outerV));
+        bits |= quint64(_mm_movemask_ps(hit)) << z;
+    }
+#else
+    for (int z = 0; z < count; ++z) {
+        const float dz = z - cz;
+        const float d = dz * dz + d2;
+        if (d >= inner && d < outer)
+            bits |= Q_UINT64_C(1) << z;
+    }
+#endif
+    if (count < 64)
+        bits &= (Q_UINT64_C(1) << count) - 1;
+    return bits;
+}
+
+PatternEngine::PatternEngine(Pattern pattern, const CubeConfig &config, quint32 seed)
+    : m_pattern(pattern)
+    , m_config(config)
+    , m_usedWords((config.ledCount() + 63) / 64)
+{
+    setDensity(m_defaultDensity);
+    for (int i = 0; i < 8; ++i) {
+        const quint32 x = (seed + quint32(i)) * 0x9E3779B9U;
+        m_lanes[i] = x ? x : 0x9E3779B9U;
+    }
+
+    const int ledCount = config.ledCount();
+    m_top.resize(ledCount);
+    for (int row = 0; row < config.sizeX * config.sizeY; ++row)
+        m_top.set(row * config.sizeZ + config.sizeZ - 1);
+    m_rain.resize(ledCount);
+    m_scratch.resize(ledCount);
+
+    // Staggered so the shells do not all grow in step.
+    for (int i = 0; i < PATTERN_SPHERE_COUNT; ++i) {
+        respawn(&m_spheres[i]);
+        m_spheres[i].radius = i * qMax(config.sizeX, qMax(config.sizeY, config.sizeZ)) / float(PATTERN_SPHERE_COUNT);
+    }
+}
+
+bool PatternEngine::patternFromString(const QString &name, Pattern *pattern)
+{
+    if (name == QLatin1String("sweep"))
+        *pattern = Sweep;
+    else if (name == QLatin1String("rain"))
+        *pattern = Rain;
+    else if (name == QLatin1String("spheres"))
+        *pattern = Spheres;
+    else if (name == QLatin1String("random"))
+        *pattern = Random;
+    else
+        return false;
+    return true;
+}
+
+void PatternEngine::next(VoxelGrid *out)
+{
+    Q_ASSERT(out->size() == m_config.ledCount());
+    switch (m_pattern) {
+    case Sweep:
+        sweep(out);
+        break;
+    case Rain:
+        rain(out);
+        break;
+    case Spheres:
+        spheres(out);
+        break;
+    case Random: {
+        // Filled a block at a time, the bits past the LED count are cleared.
+        quint64 *words = out->data();
+        fillRandom(words, out->wordCount(), m_threshold, m_lanes);
+        if (out->size() % 64)
+            words[m_usedWords - 1] &= (Q_UINT64_C(1) << (out->size() % 64)) - 1;
+        for (int i = m_usedWords; i < out->wordCount(); ++i)
+            words[i] = 0;
+        break;
+    }
+    }
+    ++m_step;
+}
+
+void PatternEngine::sweep(VoxelGrid *out)
+{
+    const int sizeX = m_config.sizeX;
+    const int sizeY = m_config.sizeY;
+    const int sizeZ = m_config.sizeZ;
+    int plane = int(m_step % quint64(sizeX + sizeY + sizeZ));
+
+    out->clear();
+    if (plane < sizeX) {
+        out->setRange(plane * sizeY * sizeZ, sizeY * sizeZ);
+        return;
+    }
+    plane -= sizeX;
+    if (plane < sizeY) {
+        for (int x = 0; x < sizeX; ++x)
+            out->setRange((x * sizeY + plane) * sizeZ, sizeZ);
+        return;
+    }
+    // Plane z is the top bit of every row moved down.
+    plane -= sizeY;
+    shiftDown(out->data(), m_top.constData(), out->wordCount(), sizeZ - 1 - plane);
+}
+
+void PatternEngine::rain(VoxelGrid *out)
+{
+    // Everything falls one LED, the top bits, which picked up the bottom of
+    // the next row, are replaced by new drops.
+    const int words = m_rain.wordCount();
+    shiftDown(m_rain.data(), m_rain.constData(), words, 1);
+    fillRandom(m_scratch.data(), words, m_threshold, m_lanes);
+    blend(m_rain.data(), m_scratch.constData(), m_top.constData(), words);
+    out->copyFrom(m_rain);
+}
+
+void PatternEngine::spheres(VoxelGrid *out)
+{
+    const int sizeX = m_config.sizeX;
+    const int sizeY = m_config.sizeY;
+    const int sizeZ = m_config.sizeZ;
+    const float maxRadius = qMax(sizeX, qMax(sizeY, sizeZ));
+
+    out->clear();
+    for (Sphere &sphere : m_spheres) {
+        const float inner = qMax(0.0f, sphere.radius - 0.5f);
+        const float outer = sphere.radius + 0.5f;
+        for (int x = 0; x < sizeX; ++x) {
+            const float dx = x - sphere.x;
+            for (int y = 0; y < sizeY; ++y) {
+                const float dy = y - sphere.y;
+                const float d2 = dx * dx + dy * dy;
+                if (d2 >= outer * outer)
+                    continue;
+                const quint64 row = shellRow(d2, sphere.z, inner * inner, outer * outer, sizeZ);
+                if (row)
+                    out->orBits((x * sizeY + y) * sizeZ, row);
+            }
+        }
+
+        sphere.radius += 0.5f;
+        if (sphere.radius > maxRadius)
+            respawn(&sphere);
+    }
+}
+
+void PatternEngine::respawn(Sphere *sphere)
+{
+    sphere->x = nextRandom() % m_config.sizeX;
+    sphere->y = nextRandom() % m_config.sizeY;
+    sphere->z = nextRandom() % m_config.sizeZ;
+    sphere->radius = 0.0f;
+}
+
+quint32 PatternEngine::nextRandom()
+{
+    m_lanes[0] = xorshift(m_lanes[0]);
+    return m_lanes[0];
+}
@@ -0,0 +1,77 @@
+// Copyright (C) 2016 The Qt Company Ltd.
+// SPDX-License-Identifier: LicenseRef-Qt-Commercial OR BSD-3-Clause
+
+#ifndef PATTERNENGINE_H
+#define PATTERNENGINE_H
+
+#include <QtGlobal>
+#include <QList>
+#include <QString>
+#include "cubeconfig.h"
+#include "voxelgrid.h"
+
+// Expanding spheres on screen at once.
+#define PATTERN_SPHERE_COUNT 3
+
+/*
+ * Built-in animations rendered straight into the packed LED bits, for demos
+ * and as a frame source that needs no device:
+ *   Sweep     a plane moving along X, then Y, then Z
+ *   Rain      drops falling towards z = 0, density is the spawn rate
+ *   Spheres   shells growing from random centres
+ *   Random    every LED lit with the given density
+ * Every call to next() advances one step, whatever the frame rate. The
+ * kernels use the same AVX2, SSE2 or 64 bit word paths as VoxelGrid.
+ */
+class PatternEngine
+{
+public:
+    enum Pattern {
+        Sweep,
+        Rain,
+        Spheres,
+        Random
+    };
+
+    explicit PatternEngine(Pattern pattern, const CubeConfig &config = CubeConfig::current(), quint32 seed = 1);
+
+    static bool patternFromString(const QString &name, Pattern *pattern);
+    static double defaultDensity() { return m_defaultDensity; }
+    static void setDefaultDensity(double ratio) { m_defaultDensity = qBound(0.0, ratio, 1.0); }
+
+    Pattern pattern() const { return m_pattern; }
+    void setDensity(double ratio) { m_threshold = int(qBound(0.0, ratio, 1.0) * 256 + 0.5); }
+    quint64 step() const { return m_step; }
+
+    // Renders the next step into a grid of the configured LED count.
+    void next(VoxelGrid *out);
+
+private:
+    struct Sphere
+    {
+        float x, y, z;
+        float radius;
+    };
+
+    void sweep(VoxelGrid *out);
+    void rain(VoxelGrid *out);
+    void spheres(VoxelGrid *out);
+    void respawn(Sphere *sphere);
+    quint32 nextRandom();
+
+    Pattern m_pattern;
+    CubeConfig m_config;
+    int m_usedWords;
+    int m_threshold;
+    quint64 m_step = 0;
+    // xorshift32 state, one per SIMD lane.
+    quint32 m_lanes[8];
+    // Bit z = sizeZ - 1 of every row.
+    VoxelGrid m_top;
+    VoxelGrid m_rain;
+    VoxelGrid m_scratch;
+    Sphere m_spheres[PATTERN_SPHERE_COUNT];
+    static double m_defaultDensity;
+};
+
+#endif // PATTERNENGINE_H
@@ -0,0 +1,154 @@
+// Copyright (C) 2016 The Qt Company Ltd.
+// SPDX-License-Identifier: LicenseRef-Qt-Commercial OR BSD-3-Clause
+
+#include "pipelinestats.h"
+#include <QtAlgorithms>
+#include <algorithm>
+
+LatencyHistogram::LatencyHistogram()
+{
+    for (std::atomic<quint32> &bucket : m_buckets)
+        bucket.store(0, std::memory_order_relaxed);
+}
+
+int LatencyHistogram::bucketFor(qint64 ns)
+{
+    const quint64 us = quint64(qMax<qint64>(ns, 0)) / 1000;
+    if (us < 4)
+        return int(us);
+    const int msb = 63 - qCountLeadingZeroBits(us);
+    const int sub = int((us >> (msb - 2)) & 3);
+    return qMin(HISTOGRAM_BUCKETS - 1, (msb - 1) * 4 + sub);
+}
+
+qint64 LatencyHistogram::bucketLimit(int bucket)
+{
+    // First microsecond of the next bucket.
+    ++bucket;
+    if (bucket < 4)
+        return qint64(bucket) * 1000;
+    const int msb = bucket / 4 + 1;
+    const int sub = bucket % 4;
+    return (qint64(4 + sub) << (msb - 2)) * 1000;
+}
+
+void LatencyHistogram::record(qint64 ns)
+{
+    m_buckets[bucketFor(ns)].fetch_add(1, std::memory_order_relaxed);
+    m_count.fetch_add(1, std::memory_order_relaxed);
+    qint64 max = m_max.load(std::memory_order_relaxed);
+    while (ns > max && !m_max.compare_exchange_weak(max, ns, std::memory_order_relaxed))
+        ;
+}
+
+void LatencyHistogram::reset()
+{
+    for (std::atomic<quint32> &bucket : m_buckets)
+        bucket.store(0, std::memory_order_relaxed);
+    m_count.store(0, std::memory_order_relaxed);
+    m_max.store(0, std::memory_order_relaxed);
+}
+
+qint64 LatencyHistogram::percentile(double p) const
+{
+    const quint64 total = count();
+    if (total == 0)
+        return 0;
+
+    const quint64 rank = qMax<quint64>(1, quint64(p * total + 0.5));
+    quint64 seen = 0;
+    for (int i = 0; i < HISTOGRAM_BUCKETS; ++i) {
+        seen += m_buckets[i].load(std::memory_order_relaxed);
+        if (seen >= rank)
+            return qMin(bucketLimit(i), max());
+    }
+    return max();
+}
+
+PipelineStats &PipelineStats::instance()
+{
+    static PipelineStats stats;
+    return stats;
+}
+
+const char *PipelineStats::stageName(Stage stage)
+{
+    switch (stage) {
+    case ReceiveToParse:
+        return "receive_to_parse";
+    case ParseToApply:
+        return "parse_to_apply";
+    case ApplyToSubmit:
+        return "apply_to_submit";
+    case SubmitToPresent:
+        return "submit_to_present";
+    case GpuDraw:
+        return "gpu_draw";
+    case RenderThread:
+        return "render_thread";
+    case Capture:
+        return "capture";
+    case EndToEnd:
+        return "end_to_end";
+    case StageCount:
+        break;
+    }
+    return "";
+}
+
+void PipelineStats::reset()
+{
+    for (LatencyHistogram &histogram : m_stages)
+        histogram.reset();
+}
+
+QJsonObject PipelineStats::toJson() const
+{
+    QJsonObject result;
+    for (int i = 0; i < StageCount; ++i) {
+        const LatencyHistogram &histogram = m_stages[i];
+        QJsonObject stage;
+        stage["count"] = qint64(histogram.count());
+        stage["p50_ms"] = histogram.percentile(0.50) / 1e6;
+        stage["p90_ms"] = histogram.percentile(0.90) / 1e6;
+        stage["p99_ms"] = histogram.percentile(0.99) / 1e6;
+        stage["max_ms"] = histogram.max() / 1e6;
+        result[stageName(Stage(i))] = stage;
+    }
+    return result;
+}
+
+QStringList PipelineStats::summary() const
+{
+    QStringList lines;
+    lines.append(QStringLiteral("%1 %2 %3 %4")
+                 .arg(QLatin1String("stage"), -18)
+                 .arg(QLatin1String("p50 ms"), 8)
+                 .arg(QLatin1String("p99 ms"), 8)
+                 .arg(QLatin1String("count"), 8));
+    for (int i = 0; i < StageCount; ++i) {
+        const LatencyHistogram &histogram = m_stages[i];
+        lines.append(QStringLiteral("%1 %2 %3 %4")
+                     .arg(QLatin1String(stageName(Stage(i))), -18)
+                     .arg(histogram.percentile(0.50) / 1e6, 8, 'f', 2)
+                     .arg(histogram.percentile(0.99) / 1e6, 8, 'f', 2)
+                     .arg(histogram.count(), 8));
+    }
+    return lines;
+}
+
+QJsonObject PipelineStats::percentiles(QList<double> samples)
+{
+    QJsonObject result;
+    if (samples.isEmpty())
+        return result;
+    std::sort(samples.begin(), samples.end());
+    auto at = [&samples](double p) {
+        return samples.at(qMin(samples.size() - 1, qsizetype(p * samples.size())));
+    };
+    result["p50"] = at(0.50);
+    result["p90"] = at(0.90);
+    result["p99"] = at(0.99);
+    result["max"] = samples.last();
+    return result;
+}
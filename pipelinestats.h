@@ -0,0 +1,89 @@
+// Copyright (C) 2016 The Qt Company Ltd.
+// SPDX-License-Identifier: LicenseRef-Qt-Commercial OR BSD-3-Clause
+
+#ifndef PIPELINESTATS_H
+#define PIPELINESTATS_H
+
+#include <QtGlobal>
+#include <QJsonObject>
+#include <QList>
+#include <QStringList>
+#include <atomic>
+
+// Four buckets per power of two from 1 us up to about 30 s.
+#define HISTOGRAM_BUCKETS 96
+
+/*
+ * Fixed size latency histogram. record() is a couple of relaxed atomic
+ * increments, so any thread may record while another one reads.
+ * Percentiles are accurate to the bucket width, under 25%.
+ */
+class LatencyHistogram
+{
+public:
+    LatencyHistogram();
+
+    void record(qint64 ns);
+    void reset();
+
+    quint64 count() const { return m_count.load(std::memory_order_relaxed); }
+    qint64 max() const { return m_max.load(std::memory_order_relaxed); }
+    // Upper bound of the bucket holding the given fraction of samples, ns.
+    qint64 percentile(double p) const;
+
+private:
+    static int bucketFor(qint64 ns);
+    static qint64 bucketLimit(int bucket);
+
+    std::atomic<quint32> m_buckets[HISTOGRAM_BUCKETS];
+    std::atomic<quint64> m_count { 0 };
+    std::atomic<qint64> m_max { 0 };
+};
+
+/*
+ * Where a frame spends its time on the way to the screen:
+ *   ReceiveToParse   socket read until the frame is complete and published
+ *   ParseToApply     waiting in the ring and the pacer until Logo::apply()
+ *   ApplyToSubmit    until paintGL() has issued the draw calls
+ *   SubmitToPresent  until the frame was swapped to the screen
+ *   GpuDraw          GPU time of the draw calls, from timer queries
+ *   RenderThread     a frame on the render thread, drawing until finished
+ *   Capture          starting and collecting read backs of captured frames
+ *   EndToEnd         socket read until presented
+ * Always on, one process wide instance.
+ */
+class PipelineStats
+{
+public:
+    enum Stage {
+        ReceiveToParse,
+        ParseToApply,
+        ApplyToSubmit,
+        SubmitToPresent,
+        GpuDraw,
+        RenderThread,
+        Capture,
+        EndToEnd,
+        StageCount
+    };
+
+    static PipelineStats &instance();
+    static const char *stageName(Stage stage);
+
+    void record(Stage stage, qint64 ns) { m_stages[stage].record(ns); }
+    const LatencyHistogram &stage(Stage stage) const { return m_stages[stage]; }
+    void reset();
+
+    QJsonObject toJson() const;
+    // One line per stage for the on-screen overlay.
+    QStringList summary() const;
+
+    // Exact p50, p90, p99 and max of samples kept by the benchmark tools,
+    // in the samples' unit.
+    static QJsonObject percentiles(QList<double> samples);
+
+private:
+    LatencyHistogram m_stages[StageCount];
+};
+
+#endif // PIPELINESTATS_H
@@ -0,0 +1,259 @@
+// Copyright (C) 2016 The Qt Company Ltd.
+// SPDX-License-Identifier: LicenseRef-Qt-Commercial OR BSD-3-Clause
+
+#include <QGuiApplication>
+#include <QCommandLineParser>
+#include <QCommandLineOption>
+#include <QOffscreenSurface>
+#include <QOpenGLContext>
+#include <QOpenGLFunctions>
+#include <QOpenGLFramebufferObject>
+#if !QT_CONFIG(opengles2)
+#include <QOpenGLTimerQuery>
+#endif
+#include <QElapsedTimer>
+#include <QRandomGenerator>
+#include <QJsonObject>
+#include <QJsonDocument>
+#include <QTextStream>
+
+#include "latticerenderer.h"
+#include "volumerenderer.h"
+#include "frameparser.h"
+#include "pipelinestats.h"
+
+/*
+ * Renders the LED lattice offscreen the way GLWidget::paintGL() does and
+ * prints one JSON object per line for every combination of profile, render
+ * mode, cube size and fill ratio. CPU time covers applying the frame and issuing the
+ * draw calls, GPU time comes from timer queries when the context has them.
+ */
+
+#define BENCH_FRAME_VARIANTS 8
+
+// Timer queries do not exist on OpenGL ES.
+class GpuTimer
+{
+public:
+#if !QT_CONFIG(opengles2)
+    bool create() { return m_query.create(); }
+    void begin() { m_query.begin(); }
+    void end() { m_query.end(); }
+    double elapsedMs() { return m_query.waitForResult() / 1e6; }
+
+private:
+    QOpenGLTimerQuery m_query;
+#else
+    bool create() { return false; }
+    void begin() {}
+    void end() {}
+    double elapsedMs() { return 0; }
+#endif
+};
+
+static QList<double> parseList(const QString &spec)
+{
+    QList<double> values;
+    for (const QString &value : spec.split(',', Qt::SkipEmptyParts))
+        values.append(value.toDouble());
+    return values;
+}
+
+static QJsonObject runCase(QOpenGLContext *context, bool core, bool volume, const CubeConfig &config,
+                           double fill, int frames, int warmup, const QSize &size, float distance)
+{
+    QOpenGLFunctions *f = context->functions();
+    Logo logo(config);
+    LatticeRenderer renderer(&logo);
+    VolumeRenderer volumeRenderer({ &logo });
+    if (volume) {
+        if (!volumeRenderer.initialize())
+            return QJsonObject();
+    } else {
+        renderer.initialize(core);
+    }
+
+    // A handful of random frames, cycled so every frame changes some LEDs.
+    QRandomGenerator random(42);
+    QList<LedFrame> variants(BENCH_FRAME_VARIANTS);
+    for (LedFrame &frame : variants) {
+        frame.resize(logo.ledCount());
+        for (int i = 0; i < logo.ledCount(); ++i)
+            frame.active.setValue(i, random.generateDouble() < fill);
+    }
+
+    QMatrix4x4 proj;
+    proj.perspective(45.0f, GLfloat(size.width()) / size.height(), 0.01f, 100.0f);
+    QMatrix4x4 camera;
+    camera.translate(0, 0, -distance);
+    QMatrix4x4 world;
+    world.rotate(180.0f, 1, 0, 0);
+
+    GpuTimer gpuTimer;
+    const bool gpuTiming = gpuTimer.create();
+
+    QList<double> cpuTimes;
+    QList<double> gpuTimes;
+    cpuTimes.reserve(frames);
+    gpuTimes.reserve(frames);
+    int drawCalls = 0;
+    QElapsedTimer timer;
+    for (int i = 0; i < warmup + frames; ++i) {
+        f->glViewport(0, 0, size.width(), size.height());
+        f->glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        f->glEnable(GL_DEPTH_TEST);
+        f->glEnable(GL_CULL_FACE);
+
+        if (gpuTiming)
+            gpuTimer.begin();
+        timer.start();
+        logo.apply(variants.at(i % variants.size()));
+        if (volume)
+            volumeRenderer.render(proj, camera * world, world.normalMatrix());
+        else
+            renderer.render(proj, camera * world, world.normalMatrix());
+        const qint64 cpu = timer.nsecsElapsed();
+        if (gpuTiming)
+            gpuTimer.end();
+        f->glFinish();
+
+        if (i < warmup)
+            continue;
+        cpuTimes.append(cpu / 1e6);
+        if (gpuTiming)
+            gpuTimes.append(gpuTimer.elapsedMs());
+        drawCalls = volume ? volumeRenderer.drawCalls() : renderer.drawCalls();
+    }
+    renderer.release();
+    volumeRenderer.release();
+
+    QJsonObject result;
+    result["profile"] = core ? "core" : "compatibility";
+    result["mode"] = volume ? "volume" : "mesh";
+    result["size"] = QString("%1x%2x%3").arg(config.sizeX).arg(config.sizeY).arg(config.sizeZ);
+    result["leds"] = config.ledCount();
+    result["fill"] = fill;
+    result["instanced"] = renderer.isInstanced();
+    result["kernel"] = VoxelGrid::kernelName();
+    result["frames"] = frames;
+    result["draw_calls"] = drawCalls;
+    result["distance"] = distance;
+    if (!volume) {
+        QJsonObject bricks;
+        bricks["culled"] = renderer.lod().brickCount(LatticeLod::Culled);
+        bricks["full"] = renderer.lod().brickCount(LatticeLod::Full);
+        bricks["merged"] = renderer.lod().brickCount(LatticeLod::Merged);
+        bricks["hidden"] = renderer.lod().brickCount(LatticeLod::Hidden);
+        result["bricks"] = bricks;
+    }
+    result["cpu_ms"] = PipelineStats::percentiles(cpuTimes);
+    result["gpu_ms"] = gpuTiming ? QJsonValue(PipelineStats::percentiles(gpuTimes)) : QJsonValue();
+    return result;
+}
+
+int main(int argc, char *argv[])
+{
+    QGuiApplication app(argc, argv);
+
+    QCoreApplication::setApplicationName("LED cube render benchmark");
+    QCommandLineParser parser;
+    parser.setApplicationDescription(QCoreApplication::applicationName());
+    parser.addHelpOption();
+    QCommandLineOption sizesOption("sizes", "Comma separated cube edge lengths", "list", "5,8,16,32,64");
+    parser.addOption(sizesOption);
+    QCommandLineOption fillOption("fill", "Comma separated ratios of lit LEDs", "list", "0,0.1,0.5,1");
+    parser.addOption(fillOption);
+    QCommandLineOption profilesOption("profiles", "Comma separated profiles: compatibility, core", "list", "compatibility,core");
+    parser.addOption(profilesOption);
+    QCommandLineOption modesOption("modes", "Comma separated render modes: mesh, volume", "list", "mesh,volume");
+    parser.addOption(modesOption);
+    QCommandLineOption framesOption("frames", "Measured frames per case", "count", "200");
+    parser.addOption(framesOption);
+    QCommandLineOption warmupOption("warmup", "Unmeasured frames per case", "count", "20");
+    parser.addOption(warmupOption);
+    QCommandLineOption distanceOption("distance", "Camera distance, the lattice spans 0.4", "units", "1");
+    parser.addOption(distanceOption);
+    QCommandLineOption lodOption("lod", "Merge bricks of LEDs smaller than <pixels>, 0 to disable", "pixels",
+                                 QString::number(LatticeLod::threshold()));
+    parser.addOption(lodOption);
+    QCommandLineOption resolutionOption("resolution", "Framebuffer size", "WxH", "800x800");
+    parser.addOption(resolutionOption);
+
+    parser.process(app);
+
+    const QStringList resolution = parser.value(resolutionOption).split('x');
+    const QSize size(resolution.value(0).toInt(), resolution.value(1).toInt());
+    const int frames = qMax(1, parser.value(framesOption).toInt());
+    const int warmup = qMax(0, parser.value(warmupOption).toInt());
+    const float distance = parser.value(distanceOption).toFloat();
+    LatticeLod::setThreshold(parser.value(lodOption).toFloat());
+    if (size.isEmpty()) {
+        qWarning("Invalid resolution \"%s\"", qPrintable(parser.value(resolutionOption)));
+        return 1;
+    }
+
+    QList<bool> modes;
+    for (const QString &mode : parser.value(modesOption).split(',', Qt::SkipEmptyParts)) {
+        if (mode != QLatin1String("mesh") && mode != QLatin1String("volume")) {
+            qWarning("Unknown render mode \"%s\"", qPrintable(mode));
+            return 1;
+        }
+        modes.append(mode == QLatin1String("volume"));
+    }
+
+    QTextStream out(stdout);
+    for (const QString &profile : parser.value(profilesOption).split(',', Qt::SkipEmptyParts)) {
+        const bool core = profile == QLatin1String("core");
+        if (!core && profile != QLatin1String("compatibility")) {
+            qWarning("Unknown profile \"%s\"", qPrintable(profile));
+            return 1;
+        }
+
+        QSurfaceFormat fmt;
+        fmt.setDepthBufferSize(24);
+        if (core) {
+            fmt.setVersion(3, 3);
+            fmt.setProfile(QSurfaceFormat::CoreProfile);
+        }
+        QOpenGLContext context;
+        context.setFormat(fmt);
+        QOffscreenSurface surface;
+        surface.setFormat(fmt);
+        surface.create();
+        if (!context.create() || !context.makeCurrent(&surface)) {
+            qWarning("Cannot create a %s profile context", qPrintable(profile));
+            continue;
+        }
+
+        QOpenGLFramebufferObject fbo(size, QOpenGLFramebufferObject::CombinedDepthStencil);
+        fbo.bind();
+        const QString glVersion = QString::fromLatin1(
+                reinterpret_cast<const char *>(context.functions()->glGetString(GL_VERSION)));
+        const QString glRenderer = QString::fromLatin1(
+                reinterpret_cast<const char *>(context.functions()->glGetString(GL_RENDERER)));
+
+        for (double edge : parseList(parser.value(sizesOption))) {
+            CubeConfig config;
+            QString error;
+            if (!config.setSize(QString::number(int(edge)), &error)) {
+                qWarning("%s", qPrintable(error));
+                continue;
+            }
+            for (bool volume : modes) {
+                for (double fill : parseList(parser.value(fillOption))) {
+                    QJsonObject result = runCase(&context, core, volume, config, fill, frames, warmup, size, distance);
+                    if (result.isEmpty()) {
+                        qWarning("Volume rendering is not available in the %s profile", qPrintable(profile));
+                        break;
+                    }
+                    result["gl_version"] = glVersion;
+                    result["gl_renderer"] = glRenderer;
+                    out << QJsonDocument(result).toJson(QJsonDocument::Compact) << Qt::endl;
+                }
+            }
+        }
+
+        fbo.release();
+    }
+    return 0;
+}
@@ -0,0 +1,220 @@
+// Copyright (C) 2016 The Qt Company Ltd.
+// SPDX-License-Identifier: LicenseRef-Qt-Commercial OR BSD-3-Clause
+
+#include "sessionfile.h"
+#include <QtEndian>
+#include <QDebug>
+#include <algorithm>
+#include <cstring>
+
+static const char SessionMagic[] = "LEDSESS1";
+static const char IndexMagic[] = "LEDSIDX1";
+
+SessionRecorder::~SessionRecorder()
+{
+    close();
+}
+
+bool SessionRecorder::open(const QString &fileName, const CubeConfig &config)
+{
+    close();
+
+    m_file.setFileName(fileName);
+    if (!m_file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        qWarning() << "Cannot record to" << fileName << ":" << m_file.errorString();
+        return false;
+    }
+
+    uchar header[SESSION_HEADER_SIZE] = {};
+    memcpy(header, SessionMagic, 8);
+    qToLittleEndian<quint16>(quint16(config.sizeX), header + 8);
+    qToLittleEndian<quint16>(quint16(config.sizeY), header + 10);
+    qToLittleEndian<quint16>(quint16(config.sizeZ), header + 12);
+    m_file.write(reinterpret_cast<const char *>(header), sizeof(header));
+
+    m_payloadSize = (config.ledCount() + 7) / 8;
+    m_record.resize(SESSION_RECORD_HEADER_SIZE + m_payloadSize);
+    m_index.clear();
+    m_firstTimestamp = -1;
+    return true;
+}
+
+bool SessionRecorder::write(const LedFrame &frame, qint64 arrival)
+{
+    if (!m_file.isOpen())
+        return false;
+
+    if (m_firstTimestamp < 0)
+        m_firstTimestamp = arrival;
+    const qint64 timestamp = arrival - m_firstTimestamp;
+
+    const int colorSize = frame.colored ? frame.active.count() * int(sizeof(quint32)) : 0;
+    m_record.resize(SESSION_RECORD_HEADER_SIZE + m_payloadSize + colorSize);
+    uchar *p = reinterpret_cast<uchar *>(m_record.data());
+    qToLittleEndian<quint64>(quint64(timestamp), p);
+    qToLittleEndian<quint16>(frame.sequence, p + 8);
+    p[10] = (frame.sequenced ? 1 : 0) | (frame.binary ? 2 : 0) | (frame.colored ? 4 : 0);
+    p[11] = 0;
+    qToLittleEndian<quint32>(quint32(m_payloadSize + colorSize), p + 12);
+
+    uchar *bits = p + SESSION_RECORD_HEADER_SIZE;
+    memset(bits, 0, m_payloadSize);
+    frame.active.toBytes(bits, m_payloadSize);
+    if (frame.colored)
+        frame.packColors(bits + m_payloadSize);
+
+    m_index.append(timestamp);
+    m_index.append(m_file.pos());
+    return m_file.write(m_record) == m_record.size();
+}
+
+void SessionRecorder::close()
+{
+    if (!m_file.isOpen())
+        return;
+
+    const qint64 indexOffset = m_file.pos();
+    QByteArray index(m_index.size() * 8, Qt::Uninitialized);
+    for (int i = 0; i < m_index.size(); ++i)
+        qToLittleEndian<quint64>(quint64(m_index.at(i)), index.data() + i * 8);
+    m_file.write(index);
+
+    uchar footer[SESSION_FOOTER_SIZE];
+    qToLittleEndian<quint64>(quint64(indexOffset), footer);
+    qToLittleEndian<quint64>(quint64(m_index.size() / 2), footer + 8);
+    memcpy(footer + 16, IndexMagic, 8);
+    m_file.write(reinterpret_cast<const char *>(footer), sizeof(footer));
+    m_file.close();
+}
+
+SessionReplay::~SessionReplay()
+{
+    close();
+}
+
+bool SessionReplay::open(const QString &fileName, const CubeConfig &config, QString *error)
+{
+    close();
+
+    m_file.setFileName(fileName);
+    if (!m_file.open(QIODevice::ReadOnly)) {
+        *error = m_file.errorString();
+        return false;
+    }
+    m_size = m_file.size();
+    m_data = m_size >= SESSION_HEADER_SIZE ? m_file.map(0, m_size) : nullptr;
+    if (!m_data || memcmp(m_data, SessionMagic, 8) != 0) {
+        *error = QStringLiteral("%1: not a recorded session").arg(fileName);
+        close();
+        return false;
+    }
+
+    const int sizeX = qFromLittleEndian<quint16>(m_data + 8);
+    const int sizeY = qFromLittleEndian<quint16>(m_data + 10);
+    const int sizeZ = qFromLittleEndian<quint16>(m_data + 12);
+    if (sizeX != config.sizeX || sizeY != config.sizeY || sizeZ != config.sizeZ) {
+        *error = QStringLiteral("%1: recorded for a %2x%3x%4 cube")
+                .arg(fileName).arg(sizeX).arg(sizeY).arg(sizeZ);
+        close();
+        return false;
+    }
+    m_payloadSize = (config.ledCount() + 7) / 8;
+
+    if (!buildIndex(error)) {
+        close();
+        return false;
+    }
+    return true;
+}
+
+void SessionReplay::close()
+{
+    if (m_data)
+        m_file.unmap(const_cast<uchar *>(m_data));
+    m_data = nullptr;
+    m_size = 0;
+    m_file.close();
+    m_timestamps.clear();
+    m_offsets.clear();
+}
+
+bool SessionReplay::buildIndex(QString *error)
+{
+    m_timestamps.clear();
+    m_offsets.clear();
+
+    // Use the stored index when close() got to write it.
+    qint64 end = m_size;
+    if (m_size >= SESSION_HEADER_SIZE + SESSION_FOOTER_SIZE) {
+        const uchar *footer = m_data + m_size - SESSION_FOOTER_SIZE;
+        const qint64 indexOffset = qint64(qFromLittleEndian<quint64>(footer));
+        const qint64 count = qint64(qFromLittleEndian<quint64>(footer + 8));
+        if (memcmp(footer + 16, IndexMagic, 8) == 0
+                && indexOffset >= SESSION_HEADER_SIZE && count >= 0 && count <= m_size / 16
+                && indexOffset + count * 16 == m_size - SESSION_FOOTER_SIZE) {
+            end = indexOffset;
+            m_timestamps.reserve(count);
+            m_offsets.reserve(count);
+            for (qint64 i = 0; i < count; ++i) {
+                const uchar *entry = m_data + indexOffset + i * 16;
+                const qint64 offset = qint64(qFromLittleEndian<quint64>(entry + 8));
+                // Every record must lie in front of the index, a damaged
+                // index is ignored and the records are walked instead.
+                if (offset < SESSION_HEADER_SIZE || offset > indexOffset - SESSION_RECORD_HEADER_SIZE)
+                    break;
+                const qint64 payload = qFromLittleEndian<quint32>(m_data + offset + 12);
+                if (payload < m_payloadSize || offset + SESSION_RECORD_HEADER_SIZE + payload > indexOffset)
+                    break;
+                m_timestamps.append(qint64(qFromLittleEndian<quint64>(entry)));
+                m_offsets.append(offset);
+            }
+            if (m_offsets.size() == count && count > 0)
+                return true;
+            m_timestamps.clear();
+            m_offsets.clear();
+        }
+    }
+
+    // Unterminated recording, walk the records up to the last complete one.
+    qint64 offset = SESSION_HEADER_SIZE;
+    while (offset + SESSION_RECORD_HEADER_SIZE <= end) {
+        const uchar *record = m_data + offset;
+        const qint64 payload = qFromLittleEndian<quint32>(record + 12);
+        if (payload < m_payloadSize || offset + SESSION_RECORD_HEADER_SIZE + payload > end)
+            break;
+        m_timestamps.append(qint64(qFromLittleEndian<quint64>(record)));
+        m_offsets.append(offset);
+        offset += SESSION_RECORD_HEADER_SIZE + payload;
+    }
+
+    if (m_offsets.isEmpty()) {
+        *error = QStringLiteral("%1: no frames recorded").arg(m_file.fileName());
+        return false;
+    }
+    return true;
+}
+
+int SessionReplay::seek(qint64 timestamp) const
+{
+    return int(std::lower_bound(m_timestamps.cbegin(), m_timestamps.cend(), timestamp)
+               - m_timestamps.cbegin());
+}
+
+bool SessionReplay::readFrame(int frame, LedFrame *out) const
+{
+    if (frame < 0 || frame >= m_offsets.size())
+        return false;
+
+    const uchar *record = m_data + m_offsets.at(frame);
+    out->sequence = qFromLittleEndian<quint16>(record + 8);
+    out->sequenced = record[10] & 1;
+    out->binary = record[10] & 2;
+
+    const uchar *bits = record + SESSION_RECORD_HEADER_SIZE;
+    out->clear();
+    out->active.setBytes(0, bits, m_payloadSize);
+    const qint64 payload = qFromLittleEndian<quint32>(record + 12);
+    if ((record[10] & 4) && payload >= m_payloadSize + out->active.count() * qint64(sizeof(quint32)))
+        out->unpackColors(bits + m_payloadSize);
+    return true;
+}
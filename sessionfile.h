@@ -0,0 +1,85 @@
+// Copyright (C) 2016 The Qt Company Ltd.
+// SPDX-License-Identifier: LicenseRef-Qt-Commercial OR BSD-3-Clause
+
+#ifndef SESSIONFILE_H
+#define SESSIONFILE_H
+
+#include <QFile>
+#include <QByteArray>
+#include <QList>
+#include "frameparser.h"
+
+/*
+ * Recorded session layout (all fields little endian):
+ *
+ *   header   8  magic "LEDSESS1"
+ *            2  sizeX, 2 sizeY, 2 sizeZ, 2 reserved
+ *   record   8  timestamp, ns since the first frame
+ *            2  sequence
+ *            1  flags, bit 0 sequenced, bit 1 binary, bit 2 color
+ *            1  reserved
+ *            4  payload size
+ *            n  LED bitmask, same bit order as binary frames, followed
+ *               by red, green, blue and intensity of every lit LED for
+ *               colored frames
+ *   index    8  timestamp, 8 file offset of the record, one per frame
+ *   footer   8  index offset, 8 frame count, 8 magic "LEDSIDX1"
+ *
+ * Records are appended as frames arrive, the index and footer are only
+ * written by close(). A file without them, e.g. after a crash, is still
+ * readable: SessionReplay rebuilds the index by walking the records.
+ */
+#define SESSION_HEADER_SIZE 16
+#define SESSION_RECORD_HEADER_SIZE 16
+#define SESSION_FOOTER_SIZE 24
+
+class SessionRecorder
+{
+public:
+    SessionRecorder() = default;
+    ~SessionRecorder();
+
+    bool open(const QString &fileName, const CubeConfig &config);
+    bool isOpen() const { return m_file.isOpen(); }
+    // Arrival is the steady clock time the frame came in, recorded in
+    // place of frame.timestamp.
+    bool write(const LedFrame &frame, qint64 arrival);
+    void close();
+
+    quint64 framesWritten() const { return quint64(m_index.size()); }
+
+private:
+    QFile m_file;
+    QByteArray m_record;
+    QList<qint64> m_index;      // timestamp, offset pairs
+    qint64 m_firstTimestamp = -1;
+    int m_payloadSize = 0;
+};
+
+class SessionReplay
+{
+public:
+    SessionReplay() = default;
+    ~SessionReplay();
+
+    bool open(const QString &fileName, const CubeConfig &config, QString *error);
+    void close();
+
+    int frameCount() const { return m_offsets.size(); }
+    qint64 timestampAt(int frame) const { return m_timestamps.at(frame); }
+    // Index of the first frame at or after the given session time.
+    int seek(qint64 timestamp) const;
+    bool readFrame(int frame, LedFrame *out) const;
+
+private:
+    bool buildIndex(QString *error);
+
+    QFile m_file;
+    const uchar *m_data = nullptr;
+    qint64 m_size = 0;
+    int m_payloadSize = 0;
+    QList<qint64> m_timestamps;
+    QList<qint64> m_offsets;
+};
+
+#endif // SESSIONFILE_H
@@ -0,0 +1,170 @@
+// Copyright (C) 2016 The Qt Company Ltd.
+// SPDX-License-Identifier: LicenseRef-Qt-Commercial OR BSD-3-Clause
+
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QCommandLineOption>
+#include <QThread>
+#include <QTimer>
+#include <QDeadlineTimer>
+#include <QJsonObject>
+#include <QJsonDocument>
+#include <QTextStream>
+
+#include "deviceemulator.h"
+#include "framereceiver.h"
+#include "logo.h"
+#include "pipelinestats.h"
+
+/*
+ * Runs the device emulator and the frame receiver in one process, each in
+ * its own thread as in the viewer, and applies every received frame to a
+ * Logo on the main thread the way GLWidget does. Prints a JSON report with
+ * throughput and the latency from send to parsed and to applied. Exits
+ * non-zero when no frame made it through or frames came back mangled.
+ *
+ * With --demo the receiver generates the frames itself, which leaves out
+ * the socket and measures the path from the frame ring to Logo::apply().
+ */
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+
+    QCoreApplication::setApplicationName("LED cube ingest soak test");
+    QCommandLineParser parser;
+    parser.setApplicationDescription(QCoreApplication::applicationName());
+    parser.addHelpOption();
+    QCommandLineOption durationOption("duration", "Test length", "seconds", "10");
+    parser.addOption(durationOption);
+    QCommandLineOption rateOption("rate", "Frames per second, 0 for as fast as acks arrive", "fps", "0");
+    parser.addOption(rateOption);
+    QCommandLineOption fillOption("fill", "Ratio of lit LEDs per frame", "ratio", "0.2");
+    parser.addOption(fillOption);
+    QCommandLineOption fragmentOption("fragment", "How frames are written: whole, random or bytes", "mode", "random");
+    parser.addOption(fragmentOption);
+    QCommandLineOption cubeSizeOption("cubesize", "Cube dimensions, e.g. 8 or 16x16x8", "size");
+    parser.addOption(cubeSizeOption);
+    QCommandLineOption demoOption("demo", "Generate frames with a built-in pattern instead of the emulator", "pattern");
+    parser.addOption(demoOption);
+
+    parser.process(app);
+
+    CubeConfig cubeConfig;
+    QString error;
+    if (parser.isSet(cubeSizeOption) && !cubeConfig.setSize(parser.value(cubeSizeOption), &error)) {
+        qWarning("%s", qPrintable(error));
+        return 1;
+    }
+    DeviceEmulator::Fragmentation fragmentation;
+    if (!DeviceEmulator::fragmentationFromString(parser.value(fragmentOption), &fragmentation)) {
+        qWarning("Unknown fragmentation \"%s\"", qPrintable(parser.value(fragmentOption)));
+        return 1;
+    }
+    const int duration = qMax(1, parser.value(durationOption).toInt());
+    const bool demo = parser.isSet(demoOption);
+    PatternEngine::Pattern pattern;
+    if (demo && !PatternEngine::patternFromString(parser.value(demoOption), &pattern)) {
+        qWarning("Unknown demo pattern \"%s\"", qPrintable(parser.value(demoOption)));
+        return 1;
+    }
+
+    QThread emulatorThread;
+    DeviceEmulator *emulator = new DeviceEmulator(cubeConfig);
+    // Latency is matched up by sequence number.
+    emulator->setSequenced(true);
+    emulator->setFrameRate(parser.value(rateOption).toDouble());
+    emulator->setFillRatio(parser.value(fillOption).toDouble());
+    emulator->setFragmentation(fragmentation);
+    emulator->moveToThread(&emulatorThread);
+    QObject::connect(&emulatorThread, &QThread::started, emulator, &DeviceEmulator::start);
+    QObject::connect(&emulatorThread, &QThread::finished, emulator, &QObject::deleteLater);
+
+    Logo logo(cubeConfig);
+    QThread networkThread;
+    FrameReceiver *receiver = nullptr;
+    QList<double> parseLatency;
+    QList<double> applyLatency;
+    quint64 framesApplied = 0;
+    quint64 framesMismatched = 0;
+    qint64 startTime = 0;
+
+    // Same consumer loop as GLWidget::frameAvailable(), minus the pacing.
+    auto drain = [&] {
+        while (const LedFrame *frame = receiver->acquireNextFrame()) {
+            logo.apply(*frame);
+            const qint64 applied = QDeadlineTimer::current(Qt::PreciseTimer).deadlineNSecs();
+            // Generated frames are sent when they are rendered.
+            const qint64 sent = demo ? frame->received : emulator->sentAt(frame->sequence);
+            if (!demo && (!frame->sequenced || sent == 0)) {
+                ++framesMismatched;
+            } else {
+                parseLatency.append((frame->timestamp - sent) / 1e6);
+                applyLatency.append((applied - sent) / 1e6);
+            }
+            ++framesApplied;
+            receiver->releaseFrame();
+        }
+    };
+
+    auto startReceiver = [&] {
+        receiver = new FrameReceiver(cubeConfig);
+        receiver->moveToThread(&networkThread);
+        QObject::connect(&networkThread, &QThread::started, receiver, &FrameReceiver::start);
+        QObject::connect(&networkThread, &QThread::finished, receiver, &QObject::deleteLater);
+        QObject::connect(receiver, &FrameReceiver::frameAvailable, &app, drain);
+        startTime = QDeadlineTimer::current(Qt::PreciseTimer).deadlineNSecs();
+        networkThread.start();
+        QTimer::singleShot(duration * 1000, &app, &QCoreApplication::quit);
+    };
+
+    if (demo) {
+        PatternEngine::setDefaultDensity(parser.value(fillOption).toDouble());
+        FrameReceiver::setDemo(parser.value(demoOption), parser.value(rateOption).toDouble());
+        startReceiver();
+    } else {
+        QObject::connect(emulator, &DeviceEmulator::listening, &app, [&](quint16 port) {
+            FrameReceiver::setEndpoint(QStringLiteral("127.0.0.1"), port);
+            FrameReceiver::setBinaryProtocol(false);
+            startReceiver();
+        });
+        emulatorThread.start();
+    }
+
+    // Give up early when the emulator cannot listen at all.
+    QTimer::singleShot((duration + 5) * 1000, &app, &QCoreApplication::quit);
+    app.exec();
+
+    const double elapsed = startTime
+            ? (QDeadlineTimer::current(Qt::PreciseTimer).deadlineNSecs() - startTime) / 1e9
+            : 0.0;
+    const quint64 framesDropped = receiver ? receiver->framesDropped() : 0;
+    networkThread.quit();
+    networkThread.wait();
+    const quint64 framesSent = emulator->framesSent();
+    const quint64 bytesSent = emulator->bytesSent();
+    const quint64 framesStalled = emulator->framesStalled();
+    emulatorThread.quit();
+    emulatorThread.wait();
+    if (demo)
+        delete emulator;
+
+    QJsonObject report;
+    report["size"] = QString("%1x%2x%3").arg(cubeConfig.sizeX).arg(cubeConfig.sizeY).arg(cubeConfig.sizeZ);
+    report["fill"] = parser.value(fillOption).toDouble();
+    report["fragment"] = demo ? QString() : parser.value(fragmentOption);
+    report["demo"] = parser.value(demoOption);
+    report["seconds"] = elapsed;
+    report["frames_sent"] = qint64(framesSent);
+    report["frames_applied"] = qint64(framesApplied);
+    report["frames_dropped"] = qint64(framesDropped);
+    report["frames_mismatched"] = qint64(framesMismatched);
+    report["frames_stalled"] = qint64(framesStalled);
+    report["frames_per_second"] = elapsed > 0 ? framesApplied / elapsed : 0.0;
+    report["bytes_per_second"] = elapsed > 0 ? bytesSent / elapsed : 0.0;
+    report["parse_latency_ms"] = PipelineStats::percentiles(parseLatency);
+    report["apply_latency_ms"] = PipelineStats::percentiles(applyLatency);
+    QTextStream(stdout) << QJsonDocument(report).toJson(QJsonDocument::Compact) << Qt::endl;
+
+    return framesApplied > 0 && framesMismatched == 0 ? 0 : 1;
+}
@@ -0,0 +1,93 @@
+// Copyright (C) 2016 The Qt Company Ltd.
+// SPDX-License-Identifier: LicenseRef-Qt-Commercial OR BSD-3-Clause
+
+#ifndef SPSCRING_H
+#define SPSCRING_H
+
+#include <QList>
+#include <atomic>
+#include <cstddef>
+
+/*
+ * Lock-free single-producer/single-consumer ring of preallocated slots.
+ * The producer fills a slot in place between beginWrite() and commitWrite().
+ * The consumer either takes slots in order with acquireNext() or jumps
+ * straight to the newest committed slot with acquireLatest(), and hands the
+ * slot back with release(). Slots skipped by acquireLatest() are recycled,
+ * so the producer only sees a full ring when the consumer falls behind.
+ */
+template <typename T>
+class SpscRing
+{
+public:
+    explicit SpscRing(int capacity = 8)
+        : m_slots(capacity)
+    {
+    }
+
+    int capacity() const { return m_slots.size(); }
+
+    // Gives every slot the same shape up front so the hot path never
+    // allocates. Only call while neither side is running.
+    template <typename Init>
+    void initialize(Init init)
+    {
+        for (T &slot : m_slots)
+            init(slot);
+        m_head.store(0, std::memory_order_relaxed);
+        m_tail.store(0, std::memory_order_relaxed);
+    }
+
+    // Producer side.
+    T *beginWrite()
+    {
+        const size_t head = m_head.load(std::memory_order_relaxed);
+        const size_t tail = m_tail.load(std::memory_order_acquire);
+        if (head - tail >= size_t(m_slots.size()))
+            return nullptr;
+        return &m_slots[head % m_slots.size()];
+    }
+
+    void commitWrite()
+    {
+        m_head.store(m_head.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+    }
+
+    // Consumer side.
+    const T *acquireLatest()
+    {
+        const size_t head = m_head.load(std::memory_order_acquire);
+        const size_t tail = m_tail.load(std::memory_order_relaxed);
+        if (head == tail)
+            return nullptr;
+
+        // Everything older than the newest slot can be overwritten right away.
+        m_reading = head - 1;
+        m_tail.store(m_reading, std::memory_order_release);
+        return &m_slots[m_reading % m_slots.size()];
+    }
+
+    const T *acquireNext()
+    {
+        const size_t head = m_head.load(std::memory_order_acquire);
+        const size_t tail = m_tail.load(std::memory_order_relaxed);
+        if (head == tail)
+            return nullptr;
+
+        m_reading = tail;
+        return &m_slots[m_reading % m_slots.size()];
+    }
+
+    void release()
+    {
+        m_tail.store(m_reading + 1, std::memory_order_release);
+    }
+
+private:
+    QList<T> m_slots;
+    alignas(64) std::atomic<size_t> m_head { 0 };
+    alignas(64) std::atomic<size_t> m_tail { 0 };
+    size_t m_reading = 0;
+};
+
+#endif // SPSCRING_H
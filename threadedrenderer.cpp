@@ -0,0 +1,248 @@
+// Copyright (C) 2016 The Qt Company Ltd.
+// SPDX-License-Identifier: LicenseRef-Qt-Commercial OR BSD-3-Clause
+
+#include "threadedrenderer.h"
+#include "latticerenderer.h"
+#include "volumerenderer.h"
+#include "framepacer.h"
+#include "pipelinestats.h"
+#include "glresourcecache.h"
+#include <QGuiApplication>
+#include <QOpenGLContext>
+#include <QOpenGLFunctions>
+#include <QOpenGLFramebufferObject>
+#include <QOffscreenSurface>
+
+ThreadedRenderer::ThreadedRenderer(int deviceCount, const CubeConfig &config, QObject *parent)
+    : QObject(parent)
+{
+    for (int i = 0; i < deviceCount; ++i) {
+        Logo *logo = new Logo(config);
+        m_logos.append(logo);
+        LedFrame frame;
+        frame.resize(logo->ledCount());
+        m_pendingFrames.append(frame);
+        m_frames.append(frame);
+        m_pendingValid.append(false);
+    }
+    m_renderer = new LatticeRenderer(m_logos);
+    m_volumeRenderer = new VolumeRenderer(m_logos);
+    m_thread.setObjectName(QStringLiteral("render"));
+}
+
+ThreadedRenderer::~ThreadedRenderer()
+{
+    stop();
+    delete m_volumeRenderer;
+    delete m_renderer;
+    qDeleteAll(m_logos);
+}
+
+bool ThreadedRenderer::start(QOpenGLContext *shareContext, bool core)
+{
+    if (m_thread.isRunning())
+        return true;
+
+    // Context and surface are made here, surfaces only exist on the GUI
+    // thread, and the context moves over to the render thread.
+    m_context = new QOpenGLContext;
+    m_context->setFormat(shareContext->format());
+    m_context->setShareContext(shareContext);
+    if (!m_context->create()) {
+        delete m_context;
+        m_context = nullptr;
+        return false;
+    }
+    m_surface = new QOffscreenSurface;
+    m_surface->setFormat(m_context->format());
+    m_surface->create();
+
+    m_threadContext = new QObject;
+    m_threadContext->moveToThread(&m_thread);
+    m_context->moveToThread(&m_thread);
+    m_thread.start();
+    bool initialized = false;
+    QMetaObject::invokeMethod(m_threadContext, [this, core, &initialized] { initialized = initializeGL(core); },
+                              Qt::BlockingQueuedConnection);
+    if (!initialized) {
+        stop();
+        return false;
+    }
+    return true;
+}
+
+void ThreadedRenderer::stop()
+{
+    if (!m_thread.isRunning())
+        return;
+    QMetaObject::invokeMethod(m_threadContext, [this] { cleanupGL(); }, Qt::BlockingQueuedConnection);
+    m_thread.quit();
+    m_thread.wait();
+    delete m_threadContext;
+    m_threadContext = nullptr;
+    delete m_context;
+    m_context = nullptr;
+    delete m_surface;
+    m_surface = nullptr;
+
+    QMutexLocker locker(&m_mutex);
+    m_renderRequested = false;
+    // The next view starts the next context off.
+    m_size = QSize();
+    m_latest = -1;
+    m_displayed = -1;
+    for (GLuint &texture : m_textures)
+        texture = 0;
+}
+
+void ThreadedRenderer::setFrame(int device, const LedFrame &frame)
+{
+    {
+        QMutexLocker locker(&m_mutex);
+        m_pendingFrames[device].copyStateFrom(frame);
+        m_pendingValid[device] = true;
+    }
+    requestRender();
+}
+
+void ThreadedRenderer::setView(const QSize &size, const QMatrix4x4 &proj, const QMatrix4x4 &modelView,
+                               const QMatrix3x3 &normalMatrix, bool volume)
+{
+    {
+        QMutexLocker locker(&m_mutex);
+        if (size == m_size && proj == m_proj && modelView == m_modelView && volume == m_volume)
+            return;
+        m_size = size;
+        m_proj = proj;
+        m_modelView = modelView;
+        m_normalMatrix = normalMatrix;
+        m_volume = volume;
+    }
+    requestRender();
+}
+
+GLuint ThreadedRenderer::acquireTexture(bool *fresh)
+{
+    QMutexLocker locker(&m_mutex);
+    if (fresh)
+        *fresh = m_latest != m_displayed;
+    m_displayed = m_latest;
+    return m_displayed < 0 ? 0 : m_textures[m_displayed];
+}
+
+quint64 ThreadedRenderer::framesRendered() const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_framesRendered;
+}
+
+void ThreadedRenderer::requestRender()
+{
+    // Whatever comes in before the render thread gets to it goes into the
+    // same frame.
+    QMutexLocker locker(&m_mutex);
+    if (m_renderRequested || !m_threadContext)
+        return;
+    m_renderRequested = true;
+    QMetaObject::invokeMethod(m_threadContext, [this] { renderFrame(); });
+}
+
+bool ThreadedRenderer::initializeGL(bool core)
+{
+    if (!m_context->makeCurrent(m_surface)) {
+        qWarning("Cannot make the render thread context current");
+        return false;
+    }
+    // The share group's cache belongs to the GUI thread.
+    GlResourceCache::createPrivate();
+    m_renderer->initialize(core);
+    m_volumeRenderer->initialize();
+    return m_renderer->isInitialized();
+}
+
+void ThreadedRenderer::renderFrame()
+{
+    QList<int> changed;
+    QMutexLocker locker(&m_mutex);
+    m_renderRequested = false;
+    if (!m_renderer->isInitialized())
+        return;
+    for (int i = 0; i < m_frames.size(); ++i) {
+        if (!m_pendingValid.at(i))
+            continue;
+        qSwap(m_frames[i], m_pendingFrames[i]);
+        m_pendingValid[i] = false;
+        changed.append(i);
+    }
+    const QSize size = m_size;
+    const QMatrix4x4 proj = m_proj;
+    const QMatrix4x4 modelView = m_modelView;
+    const QMatrix3x3 normalMatrix = m_normalMatrix;
+    const bool volume = m_volume && m_volumeRenderer->isInitialized();
+    // Neither the texture on screen nor the one waiting for it.
+    int target = 0;
+    while (target == m_latest || target == m_displayed)
+        ++target;
+    locker.unlock();
+
+    const qint64 started = FramePacer::now();
+    for (int device : changed)
+        m_logos.at(device)->apply(m_frames.at(device));
+    if (size.isEmpty()) {
+        // No view yet. The widget waits for a repaint before it takes the
+        // next frame, its paint hands over the view and asks again.
+        emit frameReady();
+        return;
+    }
+
+    QOpenGLFunctions *f = m_context->functions();
+    if (!m_targets[target] || m_targets[target]->size() != size) {
+        delete m_targets[target];
+        m_targets[target] = new QOpenGLFramebufferObject(size, QOpenGLFramebufferObject::CombinedDepthStencil);
+    }
+    m_targets[target]->bind();
+    f->glViewport(0, 0, size.width(), size.height());
+    // Transparent where nothing is drawn, the widget blends it over its own
+    // clear color.
+    f->glClearColor(0, 0, 0, 0);
+    f->glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    f->glEnable(GL_DEPTH_TEST);
+    f->glEnable(GL_CULL_FACE);
+    if (volume != m_lastVolume) {
+        // As in GLWidget::toggleRenderMode(), the other renderer's copy of
+        // the LED states went stale.
+        for (Logo *logo : m_logos)
+            logo->mark_dirty();
+        m_lastVolume = volume;
+    }
+    if (volume)
+        m_volumeRenderer->render(proj, modelView, normalMatrix);
+    else
+        m_renderer->render(proj, modelView, normalMatrix);
+    m_targets[target]->release();
+    // The widget context samples the texture, it has to be complete first.
+    f->glFinish();
+    PipelineStats::instance().record(PipelineStats::RenderThread, FramePacer::now() - started);
+
+    locker.relock();
+    m_textures[target] = m_targets[target]->texture();
+    m_latest = target;
+    ++m_framesRendered;
+    locker.unlock();
+    emit frameReady();
+}
+
+void ThreadedRenderer::cleanupGL()
+{
+    if (m_context->makeCurrent(m_surface)) {
+        for (QOpenGLFramebufferObject *&target : m_targets) {
+            delete target;
+            target = nullptr;
+        }
+        m_renderer->release();
+        m_volumeRenderer->release();
+        GlResourceCache::releasePrivate();
+        m_context->doneCurrent();
+    }
+    m_context->moveToThread(qGuiApp->thread());
+}
@@ -0,0 +1,102 @@
+// Copyright (C) 2016 The Qt Company Ltd.
+// SPDX-License-Identifier: LicenseRef-Qt-Commercial OR BSD-3-Clause
+
+#ifndef THREADEDRENDERER_H
+#define THREADEDRENDERER_H
+
+#include <QObject>
+#include <QThread>
+#include <QMutex>
+#include <QMatrix4x4>
+#include <QSize>
+#include <qopengl.h>
+#include "frameparser.h"
+
+// Framebuffers cycled through: one on screen, one finished and waiting,
+// one being drawn.
+#define RENDER_TARGET_COUNT 3
+
+QT_FORWARD_DECLARE_CLASS(QOpenGLContext)
+QT_FORWARD_DECLARE_CLASS(QOffscreenSurface)
+QT_FORWARD_DECLARE_CLASS(QOpenGLFramebufferObject)
+class Logo;
+class LatticeRenderer;
+class VolumeRenderer;
+
+/*
+ * Draws the lattice on a thread of its own, into framebuffer objects of a
+ * context sharing with the widget's, so a slow frame never holds up the
+ * GUI thread. The widget hands over frames and the view and composites
+ * whatever texture was finished last; frameReady() tells it when there is
+ * a new one. Requests arriving while a frame is drawn are folded into the
+ * next one.
+ *
+ * The render thread keeps its own Logos, LatticeRenderer and
+ * VolumeRenderer, and a GlResourceCache of its context alone for their
+ * programs and buffers; only LedFrames and matrices cross threads. Time per
+ * frame goes to PipelineStats::RenderThread, the widget's GpuDraw is then
+ * the compositing alone.
+ */
+class ThreadedRenderer : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit ThreadedRenderer(int deviceCount, const CubeConfig &config = CubeConfig::current(),
+                              QObject *parent = nullptr);
+    ~ThreadedRenderer();
+
+    // Needs the share context current. Waits for the render thread to set
+    // up its context, false when it could not, and the thread is stopped.
+    bool start(QOpenGLContext *shareContext, bool core);
+    void stop();
+
+    void setFrame(int device, const LedFrame &frame);
+    void setView(const QSize &size, const QMatrix4x4 &proj, const QMatrix4x4 &modelView,
+                 const QMatrix3x3 &normalMatrix, bool volume);
+    // Texture of the newest finished frame, 0 before the first. It is not
+    // drawn to again before the next call. fresh tells whether it is a
+    // frame not acquired before.
+    GLuint acquireTexture(bool *fresh = nullptr);
+    quint64 framesRendered() const;
+
+signals:
+    void frameReady();
+
+private:
+    void requestRender();
+    // Render thread only from here on.
+    bool initializeGL(bool core);
+    void renderFrame();
+    void cleanupGL();
+
+    QThread m_thread;
+    QObject *m_threadContext = nullptr;
+    QOpenGLContext *m_context = nullptr;
+    QOffscreenSurface *m_surface = nullptr;
+
+    mutable QMutex m_mutex;
+    // Handed over by the GUI thread, guarded by m_mutex.
+    QList<LedFrame> m_pendingFrames;
+    QList<bool> m_pendingValid;
+    QSize m_size;
+    QMatrix4x4 m_proj;
+    QMatrix4x4 m_modelView;
+    QMatrix3x3 m_normalMatrix;
+    bool m_volume = false;
+    bool m_renderRequested = false;
+    GLuint m_textures[RENDER_TARGET_COUNT] = {};
+    int m_latest = -1;
+    int m_displayed = -1;
+    quint64 m_framesRendered = 0;
+
+    // Owned by the render thread.
+    QList<LedFrame> m_frames;
+    QList<Logo *> m_logos;
+    bool m_lastVolume = false;
+    LatticeRenderer *m_renderer = nullptr;
+    VolumeRenderer *m_volumeRenderer = nullptr;
+    QOpenGLFramebufferObject *m_targets[RENDER_TARGET_COUNT] = {};
+};
+
+#endif // THREADEDRENDERER_H
@@ -0,0 +1,203 @@
+// Copyright (C) 2016 The Qt Company Ltd.
+// SPDX-License-Identifier: LicenseRef-Qt-Commercial OR BSD-3-Clause
+
+#include <QTest>
+#include <cstring>
+
+#include "frameparser.h"
+
+/*
+ * Text protocol parsing on the default 5x5x5 pin map: X15/X10, Y14/Y19 and
+ * Z27/Z20 are the first and last layer on each axis.
+ */
+class tst_FrameParser : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void completeTriples();
+    void chunkedInput();
+    void rejectedX();
+    void rejectedY();
+    void malformedToken();
+    void partialTripleAtTerminator();
+    void orphanTokens();
+    void skippedBinaryFrame();
+    void skippedColoredFrame();
+    void sequenceNumbers();
+
+private:
+    // Frames parsed from the text, in one piece or chunk bytes at a time.
+    static QList<LedFrame> parse(const char *text, int chunk = 0, quint64 *rejected = nullptr);
+    static QList<int> lit(const LedFrame &frame);
+};
+
+QList<LedFrame> tst_FrameParser::parse(const char *text, int chunk, quint64 *rejected)
+{
+    CubeConfig config;
+    FrameParser parser(config);
+    QList<LedFrame> frames;
+    parser.setFrameHandler([&frames](const LedFrame &frame) { frames.append(frame); });
+    const qsizetype size = qsizetype(strlen(text));
+    if (chunk <= 0)
+        chunk = int(size);
+    for (qsizetype i = 0; i < size; i += chunk)
+        parser.feed(text + i, qMin(qsizetype(chunk), size - i));
+    if (rejected)
+        *rejected = parser.tokensRejected();
+    return frames;
+}
+
+QList<int> tst_FrameParser::lit(const LedFrame &frame)
+{
+    QList<int> leds;
+    for (int i = 0; i < frame.active.size(); ++i) {
+        if (frame.active.test(i))
+            leds.append(i);
+    }
+    return leds;
+}
+
+void tst_FrameParser::completeTriples()
+{
+    const QList<LedFrame> frames = parse("X15:Y14:Z27:X10:Y19:Z20:----\r\n");
+    QCOMPARE(frames.size(), 1);
+    QCOMPARE(lit(frames.at(0)), QList<int>({ 0, 124 }));
+}
+
+void tst_FrameParser::chunkedInput()
+{
+    const char *text = "X15:Y14:Z27:----\r\nX10:Y19:Z20:----\r\n";
+    for (int chunk = 1; chunk <= 4; ++chunk) {
+        const QList<LedFrame> frames = parse(text, chunk);
+        QCOMPARE(frames.size(), 2);
+        QCOMPARE(lit(frames.at(0)), QList<int>({ 0 }));
+        QCOMPARE(lit(frames.at(1)), QList<int>({ 124 }));
+    }
+}
+
+void tst_FrameParser::rejectedX()
+{
+    // X99 is no layer, its Y and Z must not join the next X.
+    quint64 rejected = 0;
+    const QList<LedFrame> frames = parse("X99:Y14:Z27:X10:Y19:Z20:----\r\n", 0, &rejected);
+    QCOMPARE(frames.size(), 1);
+    QCOMPARE(lit(frames.at(0)), QList<int>({ 124 }));
+    QCOMPARE(rejected, quint64(1));
+}
+
+void tst_FrameParser::rejectedY()
+{
+    const QList<LedFrame> frames = parse("X15:Y99:Z27:X10:Y19:Z20:----\r\n");
+    QCOMPARE(frames.size(), 1);
+    QCOMPARE(lit(frames.at(0)), QList<int>({ 124 }));
+}
+
+void tst_FrameParser::malformedToken()
+{
+    // Too many digits, a letter in the digits and an unknown axis.
+    quint64 rejected = 0;
+    const QList<LedFrame> frames = parse("X1555:Y14:Z27:X1a:Y14:Z27:Q15:Y14:Z27:X10:Y19:Z20:----\r\n",
+                                         0, &rejected);
+    QCOMPARE(frames.size(), 1);
+    QCOMPARE(lit(frames.at(0)), QList<int>({ 124 }));
+    QCOMPARE(rejected, quint64(3));
+}
+
+void tst_FrameParser::partialTripleAtTerminator()
+{
+    // A triple cut short by the terminator lights nothing, in this frame
+    // or the next.
+    const QList<LedFrame> frames = parse("X15:Y14:----\r\nZ27:X10:Y19:Z20:----\r\n");
+    QCOMPARE(frames.size(), 2);
+    QVERIFY(lit(frames.at(0)).isEmpty());
+    QCOMPARE(lit(frames.at(1)), QList<int>({ 124 }));
+}
+
+void tst_FrameParser::orphanTokens()
+{
+    const QList<LedFrame> frames = parse("Y14:Z27:X15:Y14:Z27:----\r\n");
+    QCOMPARE(frames.size(), 1);
+    QCOMPARE(lit(frames.at(0)), QList<int>({ 0 }));
+}
+
+void tst_FrameParser::skippedBinaryFrame()
+{
+    // A frame of an unknown version is reported by sequence and skipped by
+    // its length, the next one is decoded and follows it without a gap.
+    QByteArray data;
+    for (int version : { BINARY_VERSION + 1, BINARY_VERSION }) {
+        const quint16 sequence = version == BINARY_VERSION ? 8 : 7;
+        const quint8 header[BINARY_HEADER_SIZE] = { BINARY_SYNC_0, BINARY_SYNC_1, quint8(version), 0,
+                                                    quint8(sequence), quint8(sequence >> 8), 16, 0 };
+        data.append(reinterpret_cast<const char *>(header), BINARY_HEADER_SIZE);
+        data.append(16, version == BINARY_VERSION ? '\x01' : '\xff');
+    }
+
+    CubeConfig config;
+    FrameParser parser(config);
+    QList<LedFrame> frames;
+    QList<quint16> skipped;
+    parser.setFrameHandler([&frames](const LedFrame &frame) { frames.append(frame); });
+    parser.setSkipHandler([&skipped](quint16 sequence) { skipped.append(sequence); });
+    parser.feed(data.constData(), data.size());
+
+    QCOMPARE(skipped, QList<quint16>({ 7 }));
+    QCOMPARE(frames.size(), 1);
+    QCOMPARE(frames.at(0).sequence, quint16(8));
+    QCOMPARE(lit(frames.at(0)).size(), 16);
+    QCOMPARE(parser.sequenceGaps(), quint64(0));
+}
+
+void tst_FrameParser::skippedColoredFrame()
+{
+    // The color bytes of a colored frame of an unknown version look like a
+    // text frame and a sync with a header of the wrong size. Neither may be
+    // taken for a frame, the next decodable header is.
+    QByteArray data;
+    const quint8 skipped[BINARY_HEADER_SIZE] = { BINARY_SYNC_0, BINARY_SYNC_1, BINARY_VERSION + 1,
+                                                 BINARY_FLAG_COLOR, 7, 0, 16, 0 };
+    data.append(reinterpret_cast<const char *>(skipped), BINARY_HEADER_SIZE);
+    data.append(16, '\x01');
+    const char text[] = "X15:Y14:Z27:----\r\n";
+    data.append(text, qsizetype(strlen(text)));
+    const quint8 fake[BINARY_HEADER_SIZE] = { BINARY_SYNC_0, BINARY_SYNC_1, BINARY_VERSION, 0, 9, 0, 15, 0 };
+    data.append(reinterpret_cast<const char *>(fake), BINARY_HEADER_SIZE);
+    data.append(3, char(BINARY_SYNC_0));
+    const quint8 next[BINARY_HEADER_SIZE] = { BINARY_SYNC_0, BINARY_SYNC_1, BINARY_VERSION, 0, 8, 0, 16, 0 };
+    data.append(reinterpret_cast<const char *>(next), BINARY_HEADER_SIZE);
+    data.append(16, '\x01');
+
+    CubeConfig config;
+    FrameParser parser(config);
+    QList<LedFrame> frames;
+    QList<quint16> skippedSequences;
+    parser.setFrameHandler([&frames](const LedFrame &frame) { frames.append(frame); });
+    parser.setSkipHandler([&skippedSequences](quint16 sequence) { skippedSequences.append(sequence); });
+    for (qsizetype i = 0; i < data.size(); ++i)
+        parser.feed(data.constData() + i, 1);
+
+    QCOMPARE(skippedSequences, QList<quint16>({ 7 }));
+    QCOMPARE(frames.size(), 1);
+    QVERIFY(frames.at(0).binary);
+    QCOMPARE(frames.at(0).sequence, quint16(8));
+    QCOMPARE(lit(frames.at(0)).size(), 16);
+}
+
+void tst_FrameParser::sequenceNumbers()
+{
+    // Sequence numbers are 16 bit, larger ones are rejected rather than
+    // wrapped and the frame goes without one.
+    quint64 rejected = 0;
+    const QList<LedFrame> frames = parse("#65535:X15:Y14:Z27:----\r\n#65536:X15:Y14:Z27:----\r\n", 0, &rejected);
+    QCOMPARE(frames.size(), 2);
+    QVERIFY(frames.at(0).sequenced);
+    QCOMPARE(frames.at(0).sequence, quint16(65535));
+    QVERIFY(!frames.at(1).sequenced);
+    QCOMPARE(lit(frames.at(1)), QList<int>({ 0 }));
+    QCOMPARE(rejected, quint64(1));
+}
+
+QTEST_APPLESS_MAIN(tst_FrameParser)
+
+#include "tst_frameparser.moc"
@@ -0,0 +1,182 @@
+// Copyright (C) 2016 The Qt Company Ltd.
+// SPDX-License-Identifier: LicenseRef-Qt-Commercial OR BSD-3-Clause
+
+#include <QTest>
+#include <QRandomGenerator>
+
+#include "voxelgrid.h"
+
+/*
+ * The bulk operations of whichever kernel set this binary was built with,
+ * checked bit by bit on random grids. CMake builds it once per kernel set
+ * so the AVX2 and SSE2 kernels are held against the plain ones.
+ */
+class tst_VoxelGrid : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+    void bulkOperations();
+    void bytes();
+    void extractRange();
+
+private:
+    static void fill(VoxelGrid *grid, QRandomGenerator &random, double ratio);
+    static bool paddingClear(const VoxelGrid &grid);
+};
+
+void tst_VoxelGrid::initTestCase()
+{
+    qInfo("Kernels: %s", VoxelGrid::kernelName());
+#if defined(VOXEL_AVX2) && (defined(Q_CC_GNU) || defined(Q_CC_CLANG))
+    if (!__builtin_cpu_supports("avx2"))
+        QSKIP("This CPU has no AVX2");
+#endif
+}
+
+void tst_VoxelGrid::fill(VoxelGrid *grid, QRandomGenerator &random, double ratio)
+{
+    grid->clear();
+    for (int i = 0; i < grid->size(); ++i) {
+        if (random.generateDouble() < ratio)
+            grid->set(i);
+    }
+}
+
+bool tst_VoxelGrid::paddingClear(const VoxelGrid &grid)
+{
+    const int used = (grid.size() + 63) / 64;
+    if (grid.size() % 64 && grid.constData()[used - 1] >> (grid.size() % 64))
+        return false;
+    for (int w = used; w < grid.wordCount(); ++w) {
+        if (grid.constData()[w])
+            return false;
+    }
+    return true;
+}
+
+void tst_VoxelGrid::bulkOperations()
+{
+    // Sizes around word and block edges, up to a 64^3 cube.
+    const int sizes[] = { 1, 63, 64, 65, 125, 255, 256, 257, 512, 4109, 262144 };
+    const double ratios[] = { 0, 0.01, 0.5, 1 };
+    QRandomGenerator random(0x5eed);
+
+    for (int size : sizes) {
+        VoxelGrid a(size);
+        VoxelGrid b(size);
+        VoxelGrid result(size);
+        for (double ratio : ratios) {
+            fill(&a, random, ratio);
+            fill(&b, random, 0.5);
+
+            int count = 0;
+            int first = -1;
+            int last = -1;
+            bool differs = false;
+            for (int i = 0; i < size; ++i) {
+                if (a.test(i)) {
+                    ++count;
+                    if (first < 0)
+                        first = i;
+                    last = i;
+                }
+                differs |= a.test(i) != b.test(i);
+            }
+            QCOMPARE(a.count(), count);
+            QCOMPARE(a.firstSetBit(), first);
+            QCOMPARE(a.lastSetBit(), last);
+
+            QCOMPARE(VoxelGrid::difference(a, b, &result), differs);
+            for (int i = 0; i < size; ++i)
+                QCOMPARE(result.test(i), a.test(i) != b.test(i));
+            QVERIFY(paddingClear(result));
+            QVERIFY(!VoxelGrid::difference(a, a, &result));
+            QCOMPARE(result.count(), 0);
+
+            result.copyFrom(a);
+            result.orWith(b);
+            for (int i = 0; i < size; ++i)
+                QCOMPARE(result.test(i), a.test(i) || b.test(i));
+            QVERIFY(paddingClear(result));
+
+            result.copyFrom(a);
+            for (int i = 0; i < size; ++i)
+                QCOMPARE(result.test(i), a.test(i));
+            QVERIFY(paddingClear(result));
+            result.clear();
+            QCOMPARE(result.count(), 0);
+            QCOMPARE(result.firstSetBit(), -1);
+
+            // Nothing may leak into the padding past size().
+            QVERIFY(paddingClear(a));
+            QVERIFY(paddingClear(result));
+        }
+    }
+}
+
+void tst_VoxelGrid::bytes()
+{
+    const int sizes[] = { 1, 7, 8, 9, 63, 64, 65, 125, 257, 4109 };
+    QRandomGenerator random(0xb17e5);
+
+    for (int size : sizes) {
+        VoxelGrid grid(size);
+        // All ones, so the bits past size() in the last byte must be
+        // dropped by setBytes().
+        QByteArray in(grid.byteCount(), char(0xff));
+        for (int i = 0; i < in.size() / 2; ++i)
+            in[i] = char(random.bounded(256));
+        grid.setBytes(0, reinterpret_cast<const uchar *>(in.constData()), in.size());
+        for (int i = 0; i < size; ++i)
+            QCOMPARE(grid.test(i), bool((uchar(in.at(i / 8)) >> (i % 8)) & 1));
+        QVERIFY(paddingClear(grid));
+
+        QByteArray out(grid.byteCount(), 0);
+        grid.toBytes(reinterpret_cast<uchar *>(out.data()), out.size());
+        if (size % 8)
+            in[in.size() - 1] = char(uchar(in.at(in.size() - 1)) & ((1 << (size % 8)) - 1));
+        QCOMPARE(out, in);
+
+        // In two pieces, as from a frame split across reads.
+        VoxelGrid pieces(size);
+        const int half = in.size() / 2;
+        pieces.setBytes(0, reinterpret_cast<const uchar *>(in.constData()), half);
+        pieces.setBytes(half, reinterpret_cast<const uchar *>(in.constData()) + half, in.size() - half);
+        VoxelGrid diff(size);
+        QVERIFY(!VoxelGrid::difference(grid, pieces, &diff));
+    }
+}
+
+void tst_VoxelGrid::extractRange()
+{
+    // Layers of cubes around word edges, and ranges at every shift.
+    const int sizes[] = { 125, 4096, 4913, 262144 };
+    QRandomGenerator random(0x1a7e2);
+
+    for (int size : sizes) {
+        VoxelGrid grid(size);
+        fill(&grid, random, 0.5);
+        const int counts[] = { 1, 25, 63, 64, 65, 256, 289, 4096 };
+        for (int count : counts) {
+            if (count > size)
+                continue;
+            QList<quint64> out((count + 63) / 64);
+            for (int first : { 0, 1, 63, 64, 65, size - count - 1, size - count }) {
+                if (first < 0 || first + count > size)
+                    continue;
+                out.fill(~Q_UINT64_C(0));
+                grid.extractRange(first, count, out.data());
+                for (int i = 0; i < out.size() * 64; ++i) {
+                    const bool bit = (out.at(i / 64) >> (i % 64)) & 1;
+                    QCOMPARE(bit, i < count && grid.test(first + i));
+                }
+            }
+        }
+    }
+}
+
+QTEST_APPLESS_MAIN(tst_VoxelGrid)
+
+#include "tst_voxelgrid.moc"
@@ -0,0 +1,308 @@
+// Copyright (C) 2016 The Qt Company Ltd.
+// SPDX-License-Identifier: LicenseRef-Qt-Commercial OR BSD-3-Clause
+
+#include "volumerenderer.h"
+#include "latticerenderer.h"
+#include <QOpenGLShaderProgram>
+#include <QOpenGLContext>
+#include <QOpenGLTexture>
+#include <QDebug>
+#include <cstddef>
+#include <cstring>
+
+// Same off look as the mesh path.
+static const QVector3D Vec3D_LightOff(0.0f, 0.0f, 1.0f);
+
+enum {
+    VertexAttrib = 0
+};
+
+// The box of a lattice in cell units, cell c spanning [c, c + 1) on every
+// axis. The version line is prepended at runtime.
+static const char *vertexShaderSource =
+    "in vec4 vertex;\n"
+    "out vec3 cellPos;\n"
+    "uniform mat4 projMatrix;\n"
+    "uniform mat4 mvMatrix;\n"
+    "uniform ivec3 u_latticeSize;\n"
+    "uniform vec3 u_origin;\n"
+    "uniform float u_pitch;\n"
+    "uniform vec3 u_latticeOffset;\n"
+    "void main() {\n"
+    "   cellPos = vertex.xyz * vec3(u_latticeSize);\n"
+    "   vec3 position = u_latticeOffset + u_origin + cellPos * u_pitch;\n"
+    "   gl_Position = projMatrix * mvMatrix * vec4(position, 1.0);\n"
+    "}\n";
+
+// The LED of cell c spans [c, c + u_ledFraction). Its color is texel
+// (z, y, x + lattice * sizeX), the linear LED index order.
+static const char *fragmentShaderSource =
+    "#ifdef GL_ES\n"
+    "precision highp float;\n"
+    "precision highp int;\n"
+    "precision highp sampler3D;\n"
+    "#endif\n"
+    "in vec3 cellPos;\n"
+    "out vec4 fragColor;\n"
+    "uniform sampler3D u_volume;\n"
+    "uniform mat4 projMatrix;\n"
+    "uniform mat4 mvMatrix;\n"
+    "uniform mat3 normalMatrix;\n"
+    "uniform vec3 lightPos;\n"
+    "uniform vec3 u_colorOff;\n"
+    "uniform ivec3 u_latticeSize;\n"
+    "uniform vec3 u_origin;\n"
+    "uniform float u_pitch;\n"
+    "uniform float u_ledFraction;\n"
+    "uniform vec3 u_latticeOffset;\n"
+    "uniform int u_latticeIndex;\n"
+    "uniform vec3 u_eye;\n"
+    "void main() {\n"
+    "   vec3 ro = u_eye;\n"
+    "   vec3 rd = cellPos - ro;\n"
+    "   rd = mix(rd, vec3(1e-6), lessThan(abs(rd), vec3(1e-6)));\n"
+    "   vec3 inv = 1.0 / rd;\n"
+    "   vec3 t1 = -ro * inv;\n"
+    "   vec3 t2 = (vec3(u_latticeSize) - ro) * inv;\n"
+    "   vec3 tMin = min(t1, t2);\n"
+    "   float t0 = max(max(max(tMin.x, tMin.y), tMin.z), 0.0);\n"
+    "   ivec3 cell = clamp(ivec3(floor(ro + rd * t0)), ivec3(0), u_latticeSize - 1);\n"
+    "   ivec3 stepDir = ivec3(sign(rd));\n"
+    "   vec3 tDelta = abs(inv);\n"
+    "   vec3 tNext = (vec3(cell) + step(0.0, rd) - ro) * inv;\n"
+    "   int steps = u_latticeSize.x + u_latticeSize.y + u_latticeSize.z;\n"
+    "   for (int i = 0; i < steps; ++i) {\n"
+    "       vec3 lo = (vec3(cell) - ro) * inv;\n"
+    "       vec3 hi = (vec3(cell) + u_ledFraction - ro) * inv;\n"
+    "       vec3 tn = min(lo, hi);\n"
+    "       vec3 tf = max(lo, hi);\n"
+    "       float tEnter = max(max(tn.x, tn.y), tn.z);\n"
+    "       float tExit = min(min(tf.x, tf.y), tf.z);\n"
+    "       if (tEnter <= tExit && tExit > 0.0) {\n"
+    "           vec3 normal = tEnter == tn.x ? vec3(-sign(rd.x), 0.0, 0.0)\n"
+    "                       : tEnter == tn.y ? vec3(0.0, -sign(rd.y), 0.0)\n"
+    "                       : vec3(0.0, 0.0, -sign(rd.z));\n"
+    "           vec4 led = texelFetch(u_volume, ivec3(cell.z, cell.y, cell.x + u_latticeIndex * u_latticeSize.x), 0);\n"
+    "           vec3 color = mix(u_colorOff, led.rgb, led.a);\n"
+    "           vec3 hit = u_latticeOffset + u_origin + (ro + rd * tEnter) * u_pitch;\n"
+    "           vec4 eye = mvMatrix * vec4(hit, 1.0);\n"
+    "           vec3 L = normalize(lightPos - eye.xyz);\n"
+    "           float NL = max(dot(normalize(normalMatrix * normal), L), 0.0);\n"
+    "           fragColor = vec4(clamp(color * 0.2 + color * 0.8 * NL, 0.0, 1.0), 1.0);\n"
+    "           vec4 clip = projMatrix * eye;\n"
+    "           gl_FragDepth = clip.z / clip.w * 0.5 + 0.5;\n"
+    "           return;\n"
+    "       }\n"
+    "       if (tNext.x < tNext.y && tNext.x < tNext.z) {\n"
+    "           cell.x += stepDir.x;\n"
+    "           tNext.x += tDelta.x;\n"
+    "       } else if (tNext.y < tNext.z) {\n"
+    "           cell.y += stepDir.y;\n"
+    "           tNext.y += tDelta.y;\n"
+    "       } else {\n"
+    "           cell.z += stepDir.z;\n"
+    "           tNext.z += tDelta.z;\n"
+    "       }\n"
+    "       if (any(lessThan(cell, ivec3(0))) || any(greaterThanEqual(cell, u_latticeSize)))\n"
+    "           break;\n"
+    "   }\n"
+    "   discard;\n"
+    "}\n";
+
+VolumeRenderer::VolumeRenderer(const QList<Logo *> &logos)
+    : m_logos(logos)
+{
+}
+
+bool VolumeRenderer::initialize()
+{
+    initializeOpenGLFunctions();
+
+    // 3D textures, texelFetch() and gl_FragDepth in GLSL 1.50 or 3.00 es.
+    QOpenGLContext *context = QOpenGLContext::currentContext();
+    const QSurfaceFormat ctxFormat = context->format();
+    const bool supported = context->isOpenGLES()
+            ? ctxFormat.majorVersion() >= 3
+            : ctxFormat.version() >= qMakePair(3, 2);
+    if (!supported)
+        return false;
+
+    const CubeConfig &config = m_logos.first()->config();
+    GLint maxSize = 0;
+    glGetIntegerv(GL_MAX_3D_TEXTURE_SIZE, &maxSize);
+    if (config.sizeX * m_logos.size() > maxSize || qMax(config.sizeY, config.sizeZ) > maxSize) {
+        qWarning() << "Volume texture for" << m_logos.size() << "lattices exceeds" << maxSize;
+        return false;
+    }
+
+    m_cache = GlResourceCache::current();
+    m_program = m_cache->program("volume");
+    if (!m_program) {
+        const QByteArray version = context->isOpenGLES()
+                ? QByteArrayLiteral("#version 300 es\n")
+                : QByteArrayLiteral("#version 150\n");
+        QOpenGLShaderProgram *program = new QOpenGLShaderProgram;
+        program->addCacheableShaderFromSourceCode(QOpenGLShader::Vertex, version + vertexShaderSource);
+        program->addCacheableShaderFromSourceCode(QOpenGLShader::Fragment, version + fragmentShaderSource);
+        program->bindAttributeLocation("vertex", VertexAttrib);
+        if (!program->link()) {
+            qWarning() << "Volume shaders:" << program->log();
+            delete program;
+            return false;
+        }
+        m_cache->insertProgram("volume", program);
+        m_program = program;
+    }
+
+    m_projMatrixLoc = m_program->uniformLocation("projMatrix");
+    m_mvMatrixLoc = m_program->uniformLocation("mvMatrix");
+    m_normalMatrixLoc = m_program->uniformLocation("normalMatrix");
+    m_lightPosLoc = m_program->uniformLocation("lightPos");
+    m_colorOffLoc = m_program->uniformLocation("u_colorOff");
+    m_latticeSizeLoc = m_program->uniformLocation("u_latticeSize");
+    m_originLoc = m_program->uniformLocation("u_origin");
+    m_pitchLoc = m_program->uniformLocation("u_pitch");
+    m_ledFractionLoc = m_program->uniformLocation("u_ledFraction");
+    m_latticeOffsetLoc = m_program->uniformLocation("u_latticeOffset");
+    m_latticeIndexLoc = m_program->uniformLocation("u_latticeIndex");
+    m_eyeLoc = m_program->uniformLocation("u_eye");
+    m_volumeLoc = m_program->uniformLocation("u_volume");
+
+    // The LED mesh is a unit cube, it doubles as the lattice box.
+    m_vao.create();
+    QOpenGLVertexArrayObject::Binder vaoBinder(&m_vao);
+    m_boxVbo = m_cache->meshVertexBuffer();
+    m_indexBuffer = m_cache->meshIndexBuffer();
+    m_indexBuffer.bind();
+    m_boxVbo.bind();
+    glEnableVertexAttribArray(VertexAttrib);
+    glVertexAttribPointer(VertexAttrib, 3, GL_BYTE, GL_FALSE, sizeof(LedVertex),
+                          reinterpret_cast<void *>(offsetof(LedVertex, position)));
+    m_boxVbo.release();
+
+    // A texture kept from an earlier context only misses what its dirty
+    // ranges say.
+    m_texture = m_cache->texture(this, QByteArrayLiteral("volume"));
+    if (!m_texture) {
+        m_texture = new QOpenGLTexture(QOpenGLTexture::Target3D);
+        m_texture->setFormat(QOpenGLTexture::RGBA8_UNorm);
+        m_texture->setSize(config.sizeZ, config.sizeY, config.sizeX * m_logos.size());
+        m_texture->setMinMagFilters(QOpenGLTexture::Nearest, QOpenGLTexture::Nearest);
+        m_texture->setWrapMode(QOpenGLTexture::ClampToEdge);
+        m_texture->allocateStorage(QOpenGLTexture::RGBA, QOpenGLTexture::UInt8);
+        m_cache->insertTexture(this, QByteArrayLiteral("volume"), m_texture);
+        uploadColors(true);
+    }
+    return true;
+}
+
+void VolumeRenderer::cleanup()
+{
+    if (m_program == nullptr)
+        return;
+    m_vao.destroy();
+    m_boxVbo = QOpenGLBuffer();
+    m_indexBuffer = QOpenGLBuffer(QOpenGLBuffer::IndexBuffer);
+    m_texture = nullptr;
+    m_program = nullptr;
+}
+
+void VolumeRenderer::release()
+{
+    cleanup();
+    if (m_cache)
+        m_cache->release(this);
+}
+
+void VolumeRenderer::setupUniforms()
+{
+    // Shared by every renderer of the share group. Light position is fixed.
+    const Logo *logo = m_logos.first();
+    const CubeConfig &config = logo->config();
+    m_program->setUniformValue(m_lightPosLoc, QVector3D(0, 0, 70));
+    m_program->setUniformValue(m_colorOffLoc, Vec3D_LightOff);
+    m_program->setUniformValue(m_originLoc, logo->origin());
+    m_program->setUniformValue(m_pitchLoc, logo->pitch());
+    m_program->setUniformValue(m_ledFractionLoc, logo->ledSize() / logo->pitch());
+    glUniform3i(m_latticeSizeLoc, config.sizeX, config.sizeY, config.sizeZ);
+    m_program->setUniformValue(m_volumeLoc, 0);
+}
+
+void VolumeRenderer::uploadColors(bool all)
+{
+    // A texture layer is one x of a lattice, sizeY rows of sizeZ texels,
+    // so a dirty LED range maps to whole layers of the Logo's colors. With
+    // plain frames the colors follow from the bits, and layers inside the
+    // range whose bits match the last upload are left alone.
+    const CubeConfig &config = m_logos.first()->config();
+    const int layerSize = config.sizeY * config.sizeZ;
+    const int layerWords = (layerSize + 63) / 64;
+    if (all) {
+        m_uploadedBits.fill(0, m_logos.size() * config.sizeX * layerWords);
+        m_uploadedPlain.fill(false, m_logos.size());
+        m_layerBits.fill(0, layerWords);
+    }
+    for (int lattice = 0; lattice < m_logos.size(); ++lattice) {
+        Logo *logo = m_logos.at(lattice);
+        if (!all && !logo->isDirty())
+            continue;
+        const int first = all ? 0 : logo->dirtyFirst() / layerSize;
+        const int last = all ? config.sizeX - 1 : logo->dirtyLast() / layerSize;
+        const bool compare = !all && m_uploadedPlain.at(lattice) && !logo->isColored();
+        int run = -1;
+        for (int x = first; x <= last + 1; ++x) {
+            bool changed = false;
+            if (x <= last) {
+                quint64 *uploaded = m_uploadedBits.data() + (lattice * config.sizeX + x) * layerWords;
+                logo->layer(x, m_layerBits.data());
+                changed = !compare || memcmp(uploaded, m_layerBits.constData(), layerWords * sizeof(quint64));
+                if (changed)
+                    memcpy(uploaded, m_layerBits.constData(), layerWords * sizeof(quint64));
+            }
+            if (changed && run < 0) {
+                run = x;
+            } else if (!changed && run >= 0) {
+                m_texture->setData(0, 0, lattice * config.sizeX + run,
+                                   config.sizeZ, config.sizeY, x - run,
+                                   QOpenGLTexture::RGBA, QOpenGLTexture::UInt8, logo->colors() + run * layerSize);
+                run = -1;
+            }
+        }
+        m_uploadedPlain[lattice] = !logo->isColored();
+        logo->clear_dirty();
+    }
+}
+
+void VolumeRenderer::render(const QMatrix4x4 &proj, const QMatrix4x4 &modelView, const QMatrix3x3 &normalMatrix)
+{
+    QOpenGLVertexArrayObject::Binder vaoBinder(&m_vao);
+    uploadColors(false);
+    m_texture->bind(0);
+
+    m_program->bind();
+    setupUniforms();
+    m_program->setUniformValue(m_projMatrixLoc, proj);
+    QMatrix4x4 gridModelView = modelView;
+    gridModelView.scale(LatticeRenderer::gridScale(m_logos.size()));
+    m_program->setUniformValue(m_mvMatrixLoc, gridModelView);
+    m_program->setUniformValue(m_normalMatrixLoc, normalMatrix);
+
+    // Back faces, so the box is still drawn with the camera inside it.
+    // Rays start at the front of the box or at the eye.
+    glCullFace(GL_FRONT);
+    const QVector3D eye = gridModelView.inverted().map(QVector3D(0, 0, 0));
+    const Logo *logo = m_logos.first();
+    m_drawCalls = 0;
+    for (int lattice = 0; lattice < m_logos.size(); ++lattice) {
+        const QVector3D offset = LatticeRenderer::latticeOffset(lattice, m_logos.size());
+        m_program->setUniformValue(m_latticeOffsetLoc, offset);
+        m_program->setUniformValue(m_latticeIndexLoc, lattice);
+        m_program->setUniformValue(m_eyeLoc, (eye - offset - logo->origin()) / logo->pitch());
+        glDrawElements(GL_TRIANGLES, Logo::meshIndexCount(), GL_UNSIGNED_BYTE, nullptr);
+        ++m_drawCalls;
+    }
+    glCullFace(GL_BACK);
+
+    m_program->release();
+    m_texture->release(0);
+}
@@ -0,0 +1,76 @@
+// Copyright (C) 2016 The Qt Company Ltd.
+// SPDX-License-Identifier: LicenseRef-Qt-Commercial OR BSD-3-Clause
+
+#ifndef VOLUMERENDERER_H
+#define VOLUMERENDERER_H
+
+#include <QOpenGLExtraFunctions>
+#include <QOpenGLVertexArrayObject>
+#include <QOpenGLBuffer>
+#include <QMatrix4x4>
+#include <QPointer>
+#include "logo.h"
+#include "glresourcecache.h"
+
+QT_FORWARD_DECLARE_CLASS(QOpenGLShaderProgram)
+QT_FORWARD_DECLARE_CLASS(QOpenGLTexture)
+
+/*
+ * Draws the same grid of lattices as LatticeRenderer, but ray marches it
+ * instead of rasterizing one cube per LED. The LED colors live in a 3D
+ * RGBA8 texture, lattice after lattice along its depth, and only the dirty
+ * layers are uploaded per frame. Every lattice is one draw of its bounding
+ * box; each covered pixel walks the cells along its ray with a 3D-DDA and
+ * shades the first LED cube it hits, writing the depth of the hit. The
+ * cost follows the covered pixels and the ray length, not the LED count.
+ *
+ * Needs OpenGL 3.2 or OpenGL ES 3.0, initialize() returns false otherwise.
+ * Program, box and texture live in the share group's GlResourceCache the
+ * way LatticeRenderer keeps its buffers.
+ */
+class VolumeRenderer : protected QOpenGLExtraFunctions
+{
+public:
+    explicit VolumeRenderer(const QList<Logo *> &logos);
+
+    bool initialize();
+    void cleanup();
+    void release();
+    bool isInitialized() const { return m_program != nullptr; }
+
+    void render(const QMatrix4x4 &proj, const QMatrix4x4 &modelView, const QMatrix3x3 &normalMatrix);
+    int drawCalls() const { return m_drawCalls; }
+
+private:
+    void setupUniforms();
+    void uploadColors(bool all);
+
+    QList<Logo *> m_logos;
+    // Layer bits of every lattice as last uploaded, layer after layer, and
+    // whether the colors then followed from them.
+    QList<quint64> m_uploadedBits;
+    QList<bool> m_uploadedPlain;
+    QList<quint64> m_layerBits;
+    QPointer<GlResourceCache> m_cache;
+    QOpenGLVertexArrayObject m_vao;
+    QOpenGLBuffer m_boxVbo;
+    QOpenGLBuffer m_indexBuffer { QOpenGLBuffer::IndexBuffer };
+    QOpenGLTexture *m_texture = nullptr;
+    QOpenGLShaderProgram *m_program = nullptr;
+    int m_projMatrixLoc = 0;
+    int m_mvMatrixLoc = 0;
+    int m_normalMatrixLoc = 0;
+    int m_lightPosLoc = 0;
+    int m_colorOffLoc = 0;
+    int m_latticeSizeLoc = 0;
+    int m_originLoc = 0;
+    int m_pitchLoc = 0;
+    int m_ledFractionLoc = 0;
+    int m_latticeOffsetLoc = 0;
+    int m_latticeIndexLoc = 0;
+    int m_eyeLoc = 0;
+    int m_volumeLoc = 0;
+    int m_drawCalls = 0;
+};
+
+#endif // VOLUMERENDERER_H
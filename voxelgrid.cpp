@@ -0,0 +1,280 @@
+// Copyright (C) 2016 The Qt Company Ltd.
+// SPDX-License-Identifier: LicenseRef-Qt-Commercial OR BSD-3-Clause
+
+#include "voxelgrid.h"
+#include <QtAlgorithms>
+#include <cstring>
+
+#if defined(VOXEL_AVX2)
+#include <immintrin.h>
+#elif defined(VOXEL_SSE2)
+#include <emmintrin.h>
+#endif
+
+void VoxelGrid::resize(int bitCount)
+{
+    m_size = qMax(0, bitCount);
+    const int words = (m_size + 63) / 64;
+    const int blocks = (words + VOXEL_WORDS_PER_BLOCK - 1) / VOXEL_WORDS_PER_BLOCK;
+    m_words.fill(0, blocks * VOXEL_WORDS_PER_BLOCK);
+}
+
+void VoxelGrid::clearPadding()
+{
+    const int used = (m_size + 63) / 64;
+    if (m_size % 64)
+        m_words[used - 1] &= (Q_UINT64_C(1) << (m_size % 64)) - 1;
+    for (int i = used; i < m_words.size(); ++i)
+        m_words[i] = 0;
+}
+
+const char *VoxelGrid::kernelName()
+{
+#if defined(VOXEL_AVX2)
+    return "avx2";
+#elif defined(VOXEL_SSE2)
+    return "sse2";
+#else
+    return "scalar";
+#endif
+}
+
+void VoxelGrid::clear()
+{
+    quint64 *p = m_words.data();
+    const int n = m_words.size();
+#if defined(VOXEL_AVX2)
+    const __m256i zero = _mm256_setzero_si256();
+    for (int i = 0; i < n; i += 4)
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(p + i), zero);
+#elif defined(VOXEL_SSE2)
+    const __m128i zero = _mm_setzero_si128();
+    for (int i = 0; i < n; i += 2)
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(p + i), zero);
+#else
+    for (int i = 0; i < n; ++i)
+        p[i] = 0;
+#endif
+}
+
+void VoxelGrid::copyFrom(const VoxelGrid &other)
+{
+    Q_ASSERT(other.m_words.size() == m_words.size());
+    quint64 *dst = m_words.data();
+    const quint64 *src = other.m_words.constData();
+    const int n = m_words.size();
+#if defined(VOXEL_AVX2)
+    for (int i = 0; i < n; i += 4)
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(dst + i),
+                            _mm256_loadu_si256(reinterpret_cast<const __m256i *>(src + i)));
+#elif defined(VOXEL_SSE2)
+    for (int i = 0; i < n; i += 2)
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + i),
+                         _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + i)));
+#else
+    for (int i = 0; i < n; ++i)
+        dst[i] = src[i];
+#endif
+}
+
+void VoxelGrid::orWith(const VoxelGrid &other)
+{
+    Q_ASSERT(other.m_words.size() == m_words.size());
+    quint64 *dst = m_words.data();
+    const quint64 *src = other.m_words.constData();
+    const int n = m_words.size();
+#if defined(VOXEL_AVX2)
+    for (int i = 0; i < n; i += 4) {
+        __m256i *d = reinterpret_cast<__m256i *>(dst + i);
+        const __m256i s = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(src + i));
+        _mm256_storeu_si256(d, _mm256_or_si256(_mm256_loadu_si256(d), s));
+    }
+#elif defined(VOXEL_SSE2)
+    for (int i = 0; i < n; i += 2) {
+        __m128i *d = reinterpret_cast<__m128i *>(dst + i);
+        const __m128i s = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + i));
+        _mm_storeu_si128(d, _mm_or_si128(_mm_loadu_si128(d), s));
+    }
+#else
+    for (int i = 0; i < n; ++i)
+        dst[i] |= src[i];
+#endif
+}
+
+bool VoxelGrid::difference(const VoxelGrid &a, const VoxelGrid &b, VoxelGrid *diff)
+{
+    Q_ASSERT(a.m_words.size() == b.m_words.size() && a.m_words.size() == diff->m_words.size());
+    const quint64 *pa = a.m_words.constData();
+    const quint64 *pb = b.m_words.constData();
+    quint64 *out = diff->m_words.data();
+    const int n = a.m_words.size();
+#if defined(VOXEL_AVX2)
+    __m256i any = _mm256_setzero_si256();
+    for (int i = 0; i < n; i += 4) {
+        const __m256i x = _mm256_xor_si256(_mm256_loadu_si256(reinterpret_cast<const __m256i *>(pa + i)),
+                                           _mm256_loadu_si256(reinterpret_cast<const __m256i *>(pb + i)));
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(out + i), x);
+        any = _mm256_or_si256(any, x);
+    }
+    return !_mm256_testz_si256(any, any);
+#elif defined(VOXEL_SSE2)
+    __m128i any = _mm_setzero_si128();
+    for (int i = 0; i < n; i += 2) {
+        const __m128i x = _mm_xor_si128(_mm_loadu_si128(reinterpret_cast<const __m128i *>(pa + i)),
+                                        _mm_loadu_si128(reinterpret_cast<const __m128i *>(pb + i)));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(out + i), x);
+        any = _mm_or_si128(any, x);
+    }
+    return _mm_movemask_epi8(_mm_cmpeq_epi8(any, _mm_setzero_si128())) != 0xFFFF;
+#else
+    quint64 any = 0;
+    for (int i = 0; i < n; ++i) {
+        out[i] = pa[i] ^ pb[i];
+        any |= out[i];
+    }
+    return any != 0;
+#endif
+}
+
+void VoxelGrid::setRange(int first, int count)
+{
+    const int end = first + count;
+    while (first < end) {
+        const int shift = first % 64;
+        const int bits = qMin(64 - shift, end - first);
+        const quint64 mask = bits == 64 ? ~Q_UINT64_C(0) : ((Q_UINT64_C(1) << bits) - 1) << shift;
+        m_words[first / 64] |= mask;
+        first += bits;
+    }
+}
+
+int VoxelGrid::count() const
+{
+    const quint64 *p = m_words.constData();
+    const int n = m_words.size();
+#if defined(VOXEL_AVX2)
+    // Nibble lookup per byte, summed with SAD into four 64 bit lanes.
+    const __m256i lookup = _mm256_setr_epi8(0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4,
+                                            0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4);
+    const __m256i low = _mm256_set1_epi8(0x0f);
+    __m256i total = _mm256_setzero_si256();
+    for (int i = 0; i < n; i += 4) {
+        const __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(p + i));
+        const __m256i bits = _mm256_add_epi8(
+                    _mm256_shuffle_epi8(lookup, _mm256_and_si256(v, low)),
+                    _mm256_shuffle_epi8(lookup, _mm256_and_si256(_mm256_srli_epi16(v, 4), low)));
+        total = _mm256_add_epi64(total, _mm256_sad_epu8(bits, _mm256_setzero_si256()));
+    }
+    return int(_mm256_extract_epi64(total, 0) + _mm256_extract_epi64(total, 1)
+               + _mm256_extract_epi64(total, 2) + _mm256_extract_epi64(total, 3));
+#elif defined(VOXEL_SSE2)
+    // SSE2 has no byte shuffle, count with the usual bit slicing per byte.
+    const __m128i m1 = _mm_set1_epi8(0x55);
+    const __m128i m2 = _mm_set1_epi8(0x33);
+    const __m128i m4 = _mm_set1_epi8(0x0f);
+    __m128i total = _mm_setzero_si128();
+    for (int i = 0; i < n; i += 2) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p + i));
+        v = _mm_sub_epi8(v, _mm_and_si128(_mm_srli_epi64(v, 1), m1));
+        v = _mm_add_epi8(_mm_and_si128(v, m2), _mm_and_si128(_mm_srli_epi64(v, 2), m2));
+        v = _mm_and_si128(_mm_add_epi8(v, _mm_srli_epi64(v, 4)), m4);
+        total = _mm_add_epi64(total, _mm_sad_epu8(v, _mm_setzero_si128()));
+    }
+    return _mm_cvtsi128_si32(total) + _mm_cvtsi128_si32(_mm_unpackhi_epi64(total, total));
+#else
+    int total = 0;
+    for (int i = 0; i < n; ++i)
+        total += qPopulationCount(p[i]);
+    return total;
+#endif
+}
+
+int VoxelGrid::firstSetBit() const
+{
+    for (int i = 0; i < m_words.size(); ++i) {
+        if (m_words.at(i))
+            return i * 64 + qCountTrailingZeroBits(m_words.at(i));
+    }
+    return -1;
+}
+
+int VoxelGrid::lastSetBit() const
+{
+    for (int i = m_words.size() - 1; i >= 0; --i) {
+        if (m_words.at(i))
+            return i * 64 + 63 - qCountLeadingZeroBits(m_words.at(i));
+    }
+    return -1;
+}
+
+void VoxelGrid::extractRange(int first, int count, quint64 *dst) const
+{
+    if (count <= 0)
+        return;
+    const quint64 *src = m_words.constData() + first / 64;
+    const int shift = first % 64;
+    const int words = (count + 63) / 64;
+    if (shift == 0) {
+        memcpy(dst, src, words * sizeof(quint64));
+    } else {
+        // Word i takes its high bits from word i + 1, which the vector loop
+        // only loads while it lies inside the storage. Padding is zero.
+        const int available = m_words.size() - first / 64 - 1;
+        int i = 0;
+#if defined(VOXEL_AVX2)
+        const __m128i right = _mm_cvtsi32_si128(shift);
+        const __m128i left = _mm_cvtsi32_si128(64 - shift);
+        for (; i + 4 <= words && i + 4 <= available; i += 4) {
+            const __m256i low = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(src + i));
+            const __m256i high = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(src + i + 1));
+            _mm256_storeu_si256(reinterpret_cast<__m256i *>(dst + i),
+                                _mm256_or_si256(_mm256_srl_epi64(low, right), _mm256_sll_epi64(high, left)));
+        }
+#elif defined(VOXEL_SSE2)
+        const __m128i right = _mm_cvtsi32_si128(shift);
+        const __m128i left = _mm_cvtsi32_si128(64 - shift);
+        for (; i + 2 <= words && i + 2 <= available; i += 2) {
+            const __m128i low = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + i));
+            const __m128i high = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + i + 1));
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + i),
+                             _mm_or_si128(_mm_srl_epi64(low, right), _mm_sll_epi64(high, left)));
+        }
+#endif
+        for (; i < words; ++i) {
+            const quint64 high = i < available ? src[i + 1] : 0;
+            dst[i] = (src[i] >> shift) | (high << (64 - shift));
+        }
+    }
+    if (count % 64)
+        dst[words - 1] &= (Q_UINT64_C(1) << (count % 64)) - 1;
+}
+
+void VoxelGrid::setBytes(int offset, const uchar *bytes, int size)
+{
+    size = qMin(size, byteCount() - offset);
+    if (size <= 0)
+        return;
+#if Q_BYTE_ORDER == Q_LITTLE_ENDIAN
+    memcpy(reinterpret_cast<uchar *>(m_words.data()) + offset, bytes, size);
+#else
+    for (int i = 0; i < size; ++i) {
+        const int byte = offset + i;
+        quint64 &word = m_words[byte / 8];
+        const int shift = (byte % 8) * 8;
+        word = (word & ~(Q_UINT64_C(0xff) << shift)) | (quint64(bytes[i]) << shift);
+    }
+#endif
+    if (offset + size == byteCount())
+        clearPadding();
+}
+
+void VoxelGrid::toBytes(uchar *bytes, int size) const
+{
+    size = qMin(size, byteCount());
+#if Q_BYTE_ORDER == Q_LITTLE_ENDIAN
+    memcpy(bytes, m_words.constData(), size);
+#else
+    for (int i = 0; i < size; ++i)
+        bytes[i] = uchar(m_words.at(i / 8) >> ((i % 8) * 8));
+#endif
+}
@@ -0,0 +1,92 @@
+// Copyright (C) 2016 The Qt Company Ltd.
+// SPDX-License-Identifier: LicenseRef-Qt-Commercial OR BSD-3-Clause
+
+#ifndef VOXELGRID_H
+#define VOXELGRID_H
+
+#include <QtGlobal>
+#include <QList>
+
+// Storage is padded to whole AVX2 registers so no kernel needs a tail loop.
+#define VOXEL_WORDS_PER_BLOCK 4
+
+// Kernel set picked at compile time, shared by everything working on the
+// grid words. Users include <immintrin.h> or <emmintrin.h> to match.
+// VOXEL_NO_SIMD forces the plain kernels.
+#if defined(VOXEL_NO_SIMD)
+#elif defined(__AVX2__)
+#define VOXEL_AVX2
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define VOXEL_SSE2
+#endif
+
+/*
+ * One bit per LED, bit n in word n / 64 at position n % 64, which is also
+ * the byte order of binary frames and recorded sessions on little endian
+ * hosts. Bulk operations run on AVX2 or SSE2 when the build targets them
+ * (e.g. -mavx2 or -march=native) and fall back to plain 64 bit words.
+ * Bits past size() are always zero.
+ */
+class VoxelGrid
+{
+public:
+    VoxelGrid() = default;
+    explicit VoxelGrid(int bitCount) { resize(bitCount); }
+
+    // Resizing clears every bit.
+    void resize(int bitCount);
+    int size() const { return m_size; }
+    int byteCount() const { return (m_size + 7) / 8; }
+    int wordCount() const { return m_words.size(); }
+    const quint64 *constData() const { return m_words.constData(); }
+    // For kernels outside this class, which must leave bits past size() zero.
+    quint64 *data() { return m_words.data(); }
+
+    bool test(int bit) const { return (m_words.at(bit / 64) >> (bit % 64)) & 1; }
+    void set(int bit) { m_words[bit / 64] |= Q_UINT64_C(1) << (bit % 64); }
+    void setValue(int bit, bool on)
+    {
+        const quint64 mask = Q_UINT64_C(1) << (bit % 64);
+        quint64 &word = m_words[bit / 64];
+        word = on ? word | mask : word & ~mask;
+    }
+    void setRange(int first, int count);
+    // ORs up to 64 bits in at any bit position.
+    void orBits(int first, quint64 bits)
+    {
+        const int shift = first % 64;
+        m_words[first / 64] |= bits << shift;
+        if (shift && (bits >> (64 - shift)))
+            m_words[first / 64 + 1] |= bits >> (64 - shift);
+    }
+
+    void clear();
+    void copyFrom(const VoxelGrid &other);
+    void orWith(const VoxelGrid &other);
+    int count() const;
+    // Stores a ^ b in diff, true when the two differ anywhere.
+    static bool difference(const VoxelGrid &a, const VoxelGrid &b, VoxelGrid *diff);
+    // -1 when no bit is set.
+    int firstSetBit() const;
+    int lastSetBit() const;
+
+    // Copies count bits starting at first to dst, bit 0 onwards, and
+    // clears the rest of the last word. With first = x * sizeY * sizeZ and
+    // count = sizeY * sizeZ this is layer x.
+    void extractRange(int first, int count, quint64 *dst) const;
+
+    // Packed little endian bytes, as in binary frames.
+    void setBytes(int offset, const uchar *bytes, int size);
+    void toBytes(uchar *bytes, int size) const;
+
+    // "avx2", "sse2" or "scalar".
+    static const char *kernelName();
+
+private:
+    void clearPadding();
+
+    QList<quint64> m_words;
+    int m_size = 0;
+};
+
+#endif // VOXELGRID_H
@@ -9,8 +9,17 @@
 #include <QHBoxLayout>
 #include <QKeyEvent>
 #include <QPushButton>
+#include <QLabel>
 #include <QApplication>
 #include <QMessageBox>
+#include <QSignalBlocker>
+
+// The widget's angles shown without being sent back to it.
+static void syncSlider(QSlider *slider, int angle)
+{
+    const QSignalBlocker blocker(slider);
+    slider->setValue(angle);
+}
 
 Window::Window(MainWindow *mw)
     : mainWindow(mw)
@@ -22,11 +31,12 @@ Window::Window(MainWindow *mw)
     zSlider = createSlider();
 
     connect(xSlider, &QSlider::valueChanged, glWidget, &GLWidget::setXRotation);
-    connect(glWidget, &GLWidget::xRotationChanged, xSlider, &QSlider::setValue);
+    connect(glWidget, &GLWidget::xRotationChanged, xSlider, [this](int angle) { syncSlider(xSlider, angle); });
     connect(ySlider, &QSlider::valueChanged, glWidget, &GLWidget::setYRotation);
-    connect(glWidget, &GLWidget::yRotationChanged, ySlider, &QSlider::setValue);
+    connect(glWidget, &GLWidget::yRotationChanged, ySlider, [this](int angle) { syncSlider(ySlider, angle); });
     connect(zSlider, &QSlider::valueChanged, glWidget, &GLWidget::setZRotation);
-    connect(glWidget, &GLWidget::zRotationChanged, zSlider, &QSlider::setValue);
+    connect(glWidget, &GLWidget::zRotationChanged, zSlider, [this](int angle) { syncSlider(zSlider, angle); });
+    connect(glWidget, &GLWidget::connectionStateChanged, this, &Window::connectionStateChanged);
 
     QVBoxLayout *mainLayout = new QVBoxLayout;
     QHBoxLayout *container = new QHBoxLayout;
@@ -38,6 +48,9 @@ Window::Window(MainWindow *mw)
     QWidget *w = new QWidget;
     w->setLayout(container);
     mainLayout->addWidget(w);
+    statusLabel = new QLabel(this);
+    mainLayout->addWidget(statusLabel);
+    connectionStateChanged(0, FrameReceiver::Disconnected);
     dockBtn = new QPushButton(tr("Undock"), this);
     connect(dockBtn, &QPushButton::clicked, this, &Window::dockUndock);
     mainLayout->addWidget(dockBtn);
@@ -66,10 +79,44 @@ void Window::keyPressEvent(QKeyEvent *e)
 {
     if (e->key() == Qt::Key_Escape)
         close();
+    else if (e->key() == Qt::Key_I)
+        glWidget->toggleStatsOverlay();
+    else if (e->key() == Qt::Key_V)
+        glWidget->toggleRenderMode();
+    else if (e->key() == Qt::Key_J)
+        glWidget->dumpStats();
+    else if (e->key() == Qt::Key_C)
+        glWidget->toggleCapture();
     else
         QWidget::keyPressEvent(e);
 }
 
+void Window::connectionStateChanged(int device, FrameReceiver::ConnectionState state)
+{
+    const DevicePool &devices = glWidget->devices();
+    if (devices.size() > 1) {
+        statusLabel->setText(tr("Connected to %1 of %2 devices")
+                             .arg(devices.connectedCount()).arg(devices.size()));
+        return;
+    }
+
+    const QString endpoint = devices.deviceName(device);
+    switch (state) {
+    case FrameReceiver::Disconnected:
+        statusLabel->setText(tr("Disconnected from %1").arg(endpoint));
+        break;
+    case FrameReceiver::Connecting:
+        statusLabel->setText(tr("Connecting to %1...").arg(endpoint));
+        break;
+    case FrameReceiver::Connected:
+        statusLabel->setText(tr("Connected to %1").arg(endpoint));
+        break;
+    case FrameReceiver::WaitingToReconnect:
+        statusLabel->setText(tr("No device at %1, retrying").arg(endpoint));
+        break;
+    }
+}
+
 void Window::dockUndock()
 {
     if (parent()) {
@@ -5,10 +5,12 @@
 #define WINDOW_H
 
 #include <QWidget>
+#include "framereceiver.h"
 
 QT_BEGIN_NAMESPACE
 class QSlider;
 class QPushButton;
+class QLabel;
 QT_END_NAMESPACE
 
 class GLWidget;
@@ -26,6 +28,7 @@ protected:
 
 private slots:
     void dockUndock();
+    void connectionStateChanged(int device, FrameReceiver::ConnectionState state);
 
 private:
     QSlider *createSlider();
@@ -35,6 +38,7 @@ private:
     QSlider *ySlider;
     QSlider *zSlider;
     QPushButton *dockBtn;
+    QLabel *statusLabel;
     MainWindow *mainWindow;
 };
 